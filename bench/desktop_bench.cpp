@@ -0,0 +1,226 @@
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <QApplication>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "alloc_track.h"
+#include "sim.h"
+#include "view.h"
+
+namespace {
+
+struct Options {
+  int frames = 300;
+  std::vector<QSize> sizes = {{480, 360}, {800, 600}, {1600, 1200}};
+  std::vector<double> scales = {1.0, 2.0};
+  std::string script = "LLRRUADLRUUA";
+  double max_p99_ms = 0.0;
+};
+
+struct Samples {
+  std::vector<double> ms;
+  unsigned long long allocs = 0;
+  unsigned long long bytes = 0;
+  long long frames = 0;
+};
+
+
+bool ParseOptions(int argc, char** argv, Options& o) {
+  for (int i = 1; i < argc; ++i) {
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!std::strcmp(a, "--frames") && v) {
+      o.frames = std::max(1, std::atoi(v));
+    } else if (!std::strcmp(a, "--script") && v) {
+      o.script = v;
+    } else if (!std::strcmp(a, "--max-p99") && v) {
+      o.max_p99_ms = std::atof(v);
+    } else if (!std::strcmp(a, "--sizes") && v) {
+      o.sizes.clear();
+      for (const QString& s : QString(v).split(',', Qt::SkipEmptyParts)) {
+        const QStringList wh = s.split('x');
+        if (wh.size() == 2) o.sizes.push_back({wh[0].toInt(), wh[1].toInt()});
+      }
+    } else if (!std::strcmp(a, "--scales") && v) {
+      o.scales.clear();
+      for (const QString& s : QString(v).split(',', Qt::SkipEmptyParts)) {
+        o.scales.push_back(s.toDouble());
+      }
+    } else {
+      std::fprintf(stderr,
+                   "usage: %s [--frames N] [--sizes WxH,...] "
+                   "[--scales S,...] [--script LRUDAPS] [--max-p99 MS]\n",
+                   argv[0]);
+      return false;
+    }
+    ++i;
+  }
+  return !o.sizes.empty() && !o.scales.empty() && !o.script.empty();
+}
+
+
+bool ScriptAction(char c, UserAction_t& out) {
+  switch (c) {
+    case 'L':
+      out = Left;
+      return true;
+    case 'R':
+      out = Right;
+      return true;
+    case 'U':
+      out = Up;
+      return true;
+    case 'D':
+      out = Down;
+      return true;
+    case 'A':
+      out = Action;
+      return true;
+    case 'P':
+      out = Pause;
+      return true;
+    case 'S':
+      out = Start;
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+void WaitForFrame(int timeout_ms) {
+  struct pollfd pfd = {sim_frame_fd(), POLLIN, 0};
+  if (pfd.fd >= 0) poll(&pfd, 1, timeout_ms);
+}
+
+
+double Percentile(std::vector<double> v, double p) {
+  if (v.empty()) return 0.0;
+  std::sort(v.begin(), v.end());
+  const size_t idx = static_cast<size_t>(p * (v.size() - 1) + 0.5);
+  return v[std::min(idx, v.size() - 1)];
+}
+
+
+void Report(const char* kind, const Samples& s) {
+  std::printf(
+      "  %-5s n=%-5zu p50=%.3f p90=%.3f p99=%.3f max=%.3f ms  "
+      "allocs/frame=%.1f bytes/frame=%.0f\n",
+      kind, s.ms.size(), Percentile(s.ms, 0.50), Percentile(s.ms, 0.90),
+      Percentile(s.ms, 0.99), Percentile(s.ms, 1.0),
+      s.frames ? static_cast<double>(s.allocs) / s.frames : 0.0,
+      s.frames ? static_cast<double>(s.bytes) / s.frames : 0.0);
+}
+
+
+void CountedEvents(const View& view, int timeout_ms, Samples& s) {
+  AllocScope allocs;
+  QElapsedTimer waited;
+  waited.start();
+  alloc_scope_begin(&allocs);
+  QCoreApplication::sendPostedEvents();
+  QCoreApplication::processEvents();
+  while (view.renderedSeq() != view.frameSeq() &&
+         waited.elapsed() < timeout_ms) {
+    usleep(200);
+    QCoreApplication::processEvents();
+  }
+  alloc_scope_end(&allocs);
+  s.allocs += allocs.count;
+  s.bytes += allocs.bytes;
+}
+
+
+int RunScale(const Options& o, double scale) {
+  int argc = 1;
+  char name[] = "desktop_bench";
+  char* argv[] = {name, nullptr};
+  QApplication app(argc, argv);
+
+  View view;
+  view.show();
+  QCoreApplication::processEvents();
+
+  int failed = 0;
+  size_t step = 0;
+  for (const QSize& size : o.sizes) {
+    view.resize(size);
+    QCoreApplication::processEvents();
+    sim_post_input(Start, true);
+    WaitForFrame(50);
+    QCoreApplication::processEvents();
+
+    Samples full, dirty;
+    for (int f = 0; f < o.frames; ++f) {
+      UserAction_t a;
+      const char c = o.script[step++ % o.script.size()];
+      if (ScriptAction(c, a)) {
+        sim_post_input(a, true);
+        if (a == Down) sim_post_input(Down, false);
+      }
+      WaitForFrame(20);
+
+      const long long paints = view.paintCount();
+      const double total = view.totalPaintMs();
+      CountedEvents(view, 20, dirty);
+      dirty.frames += 1;
+      const long long painted = view.paintCount() - paints;
+      if (painted > 0) {
+        dirty.ms.push_back((view.totalPaintMs() - total) / painted);
+      }
+
+      view.repaint();
+      full.allocs += view.lastPaintAllocs();
+      full.bytes += view.lastPaintAllocBytes();
+      full.frames += 1;
+      full.ms.push_back(view.lastPaintMs());
+    }
+
+    std::printf("desktop_bench scale=%.2f size=%dx%d frames=%d\n", scale,
+                size.width(), size.height(), o.frames);
+    Report("full", full);
+    Report("dirty", dirty);
+    if (o.max_p99_ms > 0.0 && Percentile(full.ms, 0.99) > o.max_p99_ms) {
+      std::printf("  FAIL: full p99 above %.3f ms\n", o.max_p99_ms);
+      failed = 1;
+    }
+    std::fflush(stdout);
+  }
+  return failed;
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  Options o;
+  if (!ParseOptions(argc, argv, o)) return 2;
+  setenv("QT_QPA_PLATFORM", "offscreen", 0);
+  if (!alloc_track_available()) {
+    std::printf("allocation hooks unavailable: allocs/bytes read 0\n");
+  }
+
+  int failed = 0;
+  for (double scale : o.scales) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      setenv("QT_SCALE_FACTOR", QByteArray::number(scale).constData(), 1);
+      std::_Exit(RunScale(o, scale));
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+      failed = 1;
+    }
+  }
+  return failed;
+}
@@ -0,0 +1,190 @@
+#include "engine_bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bg_clock.h"
+#include "hw_counters.h"
+
+enum { BENCH_MAX_SAMPLES = 1000 };
+
+static volatile long long bench_sink = 0;
+
+static struct {
+  const char *suite;
+  const char *filter;
+  int samples;
+  long long min_sample_ns;
+  FILE *out;
+  int cases;
+  int counters;
+  HwCounters hw;
+  HwSample sample;
+} B;
+
+
+static void bench_usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [--samples N] [--min-sample-us U] [--filter NAME] "
+          "[--out FILE] [--counters]\n",
+          prog);
+}
+
+
+int bench_begin(const char *suite, int argc, char **argv) {
+  B.suite = suite;
+  B.filter = NULL;
+  B.samples = 31;
+  B.min_sample_ns = 200000;
+  B.out = stdout;
+  B.cases = 0;
+  B.counters = 0;
+  int i = 1;
+  while (i < argc) {
+    const char *a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+    if (strcmp(a, "--counters") == 0) {
+      B.counters = 1;
+      i += 1;
+      continue;
+    }
+    if (v != NULL && strcmp(a, "--samples") == 0) {
+      B.samples = atoi(v);
+      if (B.samples < 1) B.samples = 1;
+      if (B.samples > BENCH_MAX_SAMPLES) B.samples = BENCH_MAX_SAMPLES;
+    } else if (v != NULL && strcmp(a, "--min-sample-us") == 0) {
+      B.min_sample_ns = atoll(v) * 1000;
+      if (B.min_sample_ns < 1000) B.min_sample_ns = 1000;
+    } else if (v != NULL && strcmp(a, "--filter") == 0) {
+      B.filter = v;
+    } else if (v != NULL && strcmp(a, "--out") == 0) {
+      B.out = fopen(v, "w");
+      if (B.out == NULL) {
+        perror(v);
+        return 0;
+      }
+    } else {
+      bench_usage(argv[0]);
+      return 0;
+    }
+    i += 2;
+  }
+  if (B.counters != 0 && hw_counters_open(&B.hw) == 0) {
+    fprintf(stderr, "hardware counters unavailable: %s\n",
+            strerror(B.hw.error));
+    hw_counters_close(&B.hw);
+    B.counters = 0;
+  }
+  fprintf(B.out, "{\"suite\":\"%s\",\"samples\":%d,\"results\":[", suite,
+          B.samples);
+  return 1;
+}
+
+
+void bench_keep(long long value) { bench_sink = bench_sink + value; }
+
+
+int bench_wanted(const char *name) {
+  return B.filter == NULL || strstr(name, B.filter) != NULL;
+}
+
+
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+
+static long long run_sample(BenchSetupFn setup, BenchBodyFn body, void *ctx,
+                            long long iters) {
+  if (setup != NULL) setup(ctx);
+  if (B.counters != 0) hw_counters_start(&B.hw);
+  long long t0 = bg_clock_real_ns();
+  body(ctx, iters);
+  long long ns = bg_clock_real_ns() - t0;
+  if (B.counters != 0) hw_counters_stop(&B.hw, &B.sample);
+  return ns;
+}
+
+
+static long long calibrate(BenchSetupFn setup, BenchBodyFn body, void *ctx,
+                           long long max_iters) {
+  long long iters = 1;
+  while (iters < max_iters) {
+    long long ns = run_sample(setup, body, ctx, iters);
+    if (ns >= B.min_sample_ns) break;
+    long long grow = ns > 0 ? B.min_sample_ns * iters / ns + 1 : iters * 8;
+    if (grow > iters * 8) grow = iters * 8;
+    if (grow <= iters) grow = iters * 2;
+    iters = grow < max_iters ? grow : max_iters;
+  }
+  return iters;
+}
+
+
+static void write_counters(const HwSample *hw, long long ops) {
+  const unsigned both = (1u << HW_CYCLES) | (1u << HW_INSTRUCTIONS);
+  fprintf(B.out, ",\"counters\":{");
+  const char *sep = "";
+  if ((hw->valid & both) == both && hw->value[HW_CYCLES] > 0.0) {
+    fprintf(B.out, "\"ipc\":%.3f",
+            hw->value[HW_INSTRUCTIONS] / hw->value[HW_CYCLES]);
+    sep = ",";
+  }
+  int i = 0;
+  while (i < HW_COUNTER_COUNT) {
+    if ((hw->valid & (1u << i)) != 0) {
+      fprintf(B.out, "%s\"%s\":%.3f", sep, hw_counter_name((HwCounter)i),
+              hw->value[i] / (double)ops);
+      sep = ",";
+    }
+    i++;
+  }
+  fprintf(B.out, "}");
+}
+
+
+void bench_case(const char *name, const BenchParam *params, int nparams,
+                BenchSetupFn setup, BenchBodyFn body, void *ctx,
+                long long max_iters) {
+  if (!bench_wanted(name)) return;
+  if (max_iters < 1) max_iters = 1;
+  long long iters = calibrate(setup, body, ctx, max_iters);
+
+  double ns_op[BENCH_MAX_SAMPLES];
+  memset(&B.sample, 0, sizeof(B.sample));
+  int s = 0;
+  while (s < B.samples) {
+    ns_op[s] = (double)run_sample(setup, body, ctx, iters) / (double)iters;
+    s++;
+  }
+  qsort(ns_op, (size_t)B.samples, sizeof(ns_op[0]), cmp_double);
+  int p99 = (B.samples * 99 + 99) / 100 - 1;
+
+  fprintf(B.out, "%s\n  {\"name\":\"%s\",\"params\":{", B.cases ? "," : "",
+          name);
+  int p = 0;
+  while (p < nparams) {
+    fprintf(B.out, "%s\"%s\":%lld", p ? "," : "", params[p].key,
+            params[p].value);
+    p++;
+  }
+  fprintf(B.out,
+          "},\"iterations\":%lld,\"min_ns\":%.2f,\"median_ns\":%.2f,"
+          "\"p99_ns\":%.2f",
+          iters * B.samples, ns_op[0], ns_op[B.samples / 2], ns_op[p99]);
+  if (B.sample.valid != 0) write_counters(&B.sample, iters * B.samples);
+  fprintf(B.out, "}");
+  fflush(B.out);
+  B.cases++;
+}
+
+
+int bench_end(void) {
+  if (B.counters != 0) hw_counters_close(&B.hw);
+  fprintf(B.out, "\n]}\n");
+  if (B.out != stdout) fclose(B.out);
+  return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef ENGINE_BENCH_H_
+#define ENGINE_BENCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  const char *key;
+  long long value;
+} BenchParam;
+
+typedef void (*BenchSetupFn)(void *ctx);
+typedef void (*BenchBodyFn)(void *ctx, long long iters);
+
+void bench_keep(long long value);
+
+int bench_begin(const char *suite, int argc, char **argv);
+int bench_wanted(const char *name);
+void bench_case(const char *name, const BenchParam *params, int nparams,
+                BenchSetupFn setup, BenchBodyFn body, void *ctx,
+                long long max_iters);
+int bench_end(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bg_clock.h"
+#include "brick_game_api.h"
+#include "replay.h"
+
+enum {
+  FUZZ_MAX_KEEP = 32,
+  FUZZ_MAX_FRAMES = 1 << 16,
+  FUZZ_REPEATS = 3
+};
+
+typedef struct {
+  Replay seq;
+  long long worst_ns;
+  int worst_frame;
+  int frames;
+} FuzzEntry;
+
+static struct {
+  double seconds;
+  int frames;
+  int keep;
+  unsigned rng;
+  int rows;
+  int cols;
+  const char *out;
+  const char *check;
+  double budget_us;
+} F;
+
+static long long frame_ns[FUZZ_MAX_FRAMES];
+static long long frame_best[FUZZ_MAX_FRAMES];
+static FuzzEntry corpus[FUZZ_MAX_KEEP];
+static int corpus_size = 0;
+
+
+static void fuzz_usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [--seconds S] [--frames N] [--keep K] [--seed U] "
+          "[--size RxC] [--out FILE]\n"
+          "       %s --check FILE [--budget-us U] [--size RxC]\n",
+          prog, prog);
+}
+
+
+static int fuzz_options(int argc, char **argv) {
+  F.seconds = 10.0;
+  F.frames = 2000;
+  F.keep = 8;
+  F.rng = 0x9E3779B9u;
+  int i = 1;
+  while (i < argc) {
+    const char *a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+    if (v == NULL) {
+      fuzz_usage(argv[0]);
+      return 0;
+    }
+    if (strcmp(a, "--seconds") == 0) {
+      F.seconds = atof(v);
+    } else if (strcmp(a, "--frames") == 0) {
+      F.frames = atoi(v);
+    } else if (strcmp(a, "--keep") == 0) {
+      F.keep = atoi(v);
+    } else if (strcmp(a, "--seed") == 0) {
+      F.rng = (unsigned)strtoul(v, NULL, 0);
+    } else if (strcmp(a, "--size") == 0) {
+      if (sscanf(v, "%dx%d", &F.rows, &F.cols) != 2) F.rows = -1;
+    } else if (strcmp(a, "--out") == 0) {
+      F.out = v;
+    } else if (strcmp(a, "--check") == 0) {
+      F.check = v;
+    } else if (strcmp(a, "--budget-us") == 0) {
+      F.budget_us = atof(v);
+    } else {
+      fuzz_usage(argv[0]);
+      return 0;
+    }
+    i += 2;
+  }
+  if (F.frames < 1) F.frames = 1;
+  if (F.frames > FUZZ_MAX_FRAMES) F.frames = FUZZ_MAX_FRAMES;
+  if (F.keep < 1) F.keep = 1;
+  if (F.keep > FUZZ_MAX_KEEP) F.keep = FUZZ_MAX_KEEP;
+  if (F.rng == 0) F.rng = 1;
+  if (F.rows < 0) {
+    fuzz_usage(argv[0]);
+    return 0;
+  }
+  return 1;
+}
+
+
+static unsigned fuzz_next(void) {
+  F.rng ^= F.rng << 13;
+  F.rng ^= F.rng >> 17;
+  F.rng ^= F.rng << 5;
+  return F.rng;
+}
+
+
+static int fuzz_below(int n) { return n > 0 ? (int)(fuzz_next() % n) : 0; }
+
+
+static UserAction_t fuzz_action(void) {
+  static const UserAction_t WEIGHTED[] = {Left, Right, Up,     Down,  Action,
+                                          Left, Right, Down,   Action, Up,
+                                          Start, Pause};
+  int n = (int)(sizeof(WEIGHTED) / sizeof(WEIGHTED[0]));
+  int pick = fuzz_below(n);
+  if (pick == n - 1 && fuzz_below(4) != 0) pick = 0;
+  return WEIGHTED[pick];
+}
+
+
+static int run_sequence(const Replay *r, long long *ns) {
+  GameInstance_t *game = gameCreate();
+  gameSelect(game);
+  setHighScorePersistence(0);
+  if (F.rows > 0) setFieldSize(F.rows, F.cols);
+  setRandomSeed(r->seed);
+  bg_clock_set_manual(1);
+
+  int step = 0;
+  int next = 0;
+  int frames = r->frames < FUZZ_MAX_FRAMES ? r->frames : FUZZ_MAX_FRAMES;
+  while (step < frames) {
+    while (next < r->count && r->events[next].step <= step) {
+      userInput(r->events[next].action, r->events[next].hold != 0);
+      next = next + 1;
+    }
+    long long t0 = bg_clock_real_ns();
+    GameInfo_t g = updateCurrentState();
+    ns[step] = bg_clock_real_ns() - t0;
+    int delay = bg_frame_delay_ms(0, g.pause, g.speed);
+    freeGameInfo(&g);
+    step = step + 1;
+    if (isGameOver()) break;
+    bg_clock_advance_ns((long long)delay * 1000000LL);
+  }
+
+  bg_clock_set_manual(0);
+  gameSelect(NULL);
+  gameDestroy(game);
+  return step;
+}
+
+
+static long long measure(const Replay *r, int *worst_frame, int *ran) {
+  int frames = 0;
+  int rep = 0;
+  while (rep < FUZZ_REPEATS) {
+    int n = run_sequence(r, frame_ns);
+    int i = 0;
+    while (i < n) {
+      if (rep == 0 || frame_ns[i] < frame_best[i]) frame_best[i] = frame_ns[i];
+      i++;
+    }
+    frames = n;
+    rep++;
+  }
+  long long worst = 0;
+  *worst_frame = 0;
+  *ran = frames;
+  int i = 0;
+  while (i < frames) {
+    if (frame_best[i] > worst) {
+      worst = frame_best[i];
+      *worst_frame = i;
+    }
+    i++;
+  }
+  return worst;
+}
+
+
+static void random_sequence(Replay *r) {
+  memset(r, 0, sizeof(*r));
+  snprintf(r->game, sizeof(r->game), "%s", gameName());
+  r->seed = fuzz_next();
+  r->frames = F.frames;
+  replay_append(r, 0, Start, 0);
+  int step = 1 + fuzz_below(4);
+  while (step < F.frames) {
+    replay_append(r, step, fuzz_action(), fuzz_below(2));
+    step += 1 + fuzz_below(12);
+  }
+}
+
+
+static void copy_events(Replay *dst, const Replay *src, int from, int to) {
+  int i = from;
+  while (i < to) {
+    const ReplayEvent *e = &src->events[i];
+    replay_append(dst, e->step, e->action, e->hold);
+    i++;
+  }
+}
+
+
+static void mutate(const Replay *parent, Replay *child) {
+  memset(child, 0, sizeof(*child));
+  snprintf(child->game, sizeof(child->game), "%s", parent->game);
+  child->seed = parent->seed;
+  child->frames = parent->frames;
+  int n = parent->count;
+  int at = n > 1 ? 1 + fuzz_below(n - 1) : n;
+  int kind = fuzz_below(6);
+  if (kind == 0) {
+    copy_events(child, parent, 0, n);
+    child->seed = fuzz_next();
+  } else if (kind == 1 && at < n) {
+    copy_events(child, parent, 0, at);
+    copy_events(child, parent, at + 1, n);
+  } else if (kind == 2 && at < n) {
+    copy_events(child, parent, 0, n);
+    child->events[at].action = fuzz_action();
+    child->events[at].hold = fuzz_below(2);
+  } else if (kind == 3 && corpus_size > 1) {
+    const Replay *other = &corpus[fuzz_below(corpus_size)].seq;
+    int cut = at < n ? parent->events[at].step : parent->frames;
+    copy_events(child, parent, 0, at);
+    int j = 0;
+    while (j < other->count && other->events[j].step <= cut) j++;
+    copy_events(child, other, j, other->count);
+  } else {
+    int lo = at > 0 && at <= n ? parent->events[at - 1].step : 0;
+    int hi = at < n ? parent->events[at].step : child->frames - 1;
+    copy_events(child, parent, 0, at);
+    int burst = 1 + fuzz_below(kind == 5 ? 16 : 2);
+    UserAction_t action = fuzz_action();
+    while (burst > 0 && lo <= hi) {
+      replay_append(child, lo, action, fuzz_below(2));
+      lo += fuzz_below(2);
+      burst--;
+    }
+    copy_events(child, parent, at, n);
+  }
+  if (child->count == 0) replay_append(child, 0, Start, 0);
+}
+
+
+static int corpus_offer(Replay *seq, long long worst_ns, int worst_frame,
+                        int frames) {
+  int pos = corpus_size;
+  while (pos > 0 && corpus[pos - 1].worst_ns < worst_ns) pos--;
+  if (pos >= F.keep) {
+    replay_free(seq);
+    return 0;
+  }
+  if (corpus_size == F.keep) {
+    replay_free(&corpus[corpus_size - 1].seq);
+    corpus_size = corpus_size - 1;
+  }
+  memmove(&corpus[pos + 1], &corpus[pos],
+          sizeof(corpus[0]) * (size_t)(corpus_size - pos));
+  corpus[pos].seq = *seq;
+  corpus[pos].worst_ns = worst_ns;
+  corpus[pos].worst_frame = worst_frame;
+  corpus[pos].frames = frames;
+  corpus_size = corpus_size + 1;
+  return pos == 0;
+}
+
+
+static int fuzz_check(void) {
+  Replay r;
+  if (replay_load(F.check, &r) == 0) {
+    fprintf(stderr, "cannot read replay: %s\n", F.check);
+    return 2;
+  }
+  if (r.frames <= 0) r.frames = F.frames;
+  int frame = 0;
+  int ran = 0;
+  long long worst = measure(&r, &frame, &ran);
+  printf("frame_fuzz game=%s check=%s frames=%d worst=%.1f us at frame %d\n",
+         gameName(), F.check, ran, (double)worst / 1000.0, frame);
+  replay_free(&r);
+  if (F.budget_us > 0.0 && (double)worst / 1000.0 > F.budget_us) {
+    printf("FAIL: worst frame above %.1f us\n", F.budget_us);
+    return 1;
+  }
+  return 0;
+}
+
+
+static int fuzz_save(const FuzzEntry *best) {
+  Replay r = best->seq;
+  r.frames = best->worst_frame + 1;
+  while (r.count > 0 && r.events[r.count - 1].step > best->worst_frame) {
+    r.count = r.count - 1;
+  }
+  if (replay_save(F.out, &r) == 0) {
+    fprintf(stderr, "cannot write %s\n", F.out);
+    return 2;
+  }
+  return 0;
+}
+
+
+int main(int argc, char **argv) {
+  if (fuzz_options(argc, argv) == 0) return 2;
+  if (F.check != NULL) return fuzz_check();
+
+  long long t0 = bg_clock_real_ns();
+  long long budget = (long long)(F.seconds * 1e9);
+  long long runs = 0;
+  while (bg_clock_real_ns() - t0 < budget) {
+    Replay child;
+    if (corpus_size < F.keep || fuzz_below(8) == 0) {
+      random_sequence(&child);
+    } else {
+      int a = fuzz_below(corpus_size);
+      int b = fuzz_below(corpus_size);
+      mutate(&corpus[a < b ? a : b].seq, &child);
+    }
+    int frame = 0;
+    int ran = 0;
+    long long worst = measure(&child, &frame, &ran);
+    runs = runs + 1;
+    if (corpus_offer(&child, worst, frame, ran) != 0) {
+      printf("run %lld: new worst %.1f us at frame %d (%d events)\n", runs,
+             (double)worst / 1000.0, frame, corpus[0].seq.count);
+      fflush(stdout);
+    }
+  }
+
+  printf("frame_fuzz game=%s runs=%lld seconds=%.1f\n", gameName(), runs,
+         (double)(bg_clock_real_ns() - t0) / 1e9);
+  int i = 0;
+  while (i < corpus_size) {
+    printf("  #%d worst=%.1f us at frame %d of %d seed=%u events=%d\n", i,
+           (double)corpus[i].worst_ns / 1000.0, corpus[i].worst_frame,
+           corpus[i].frames, corpus[i].seq.seed, corpus[i].seq.count);
+    i++;
+  }
+  int status = corpus_size > 0 && F.out != NULL ? fuzz_save(&corpus[0]) : 0;
+  while (corpus_size > 0) {
+    corpus_size = corpus_size - 1;
+    replay_free(&corpus[corpus_size].seq);
+  }
+  return status;
+}
@@ -0,0 +1,76 @@
+#!/bin/sh
+# Builds snake_console and tetris_console with PGO+LTO trained on replays/,
+# then times both builds on the same corpus.
+set -e
+
+MAKE=${MAKE:-make}
+OUT=_pgo
+PROFILE=$(pwd)/$OUT/profile
+TRAIN_RUNS=${PGO_TRAIN_RUNS:-5}
+ROUNDS=${PGO_ROUNDS:-7}
+GAMES="snake tetris"
+BINS="snake_console tetris_console"
+
+corpus() {
+  for f in replays/*.txt; do
+    if grep -q "^game $1\$" "$f"; then echo "$f"; fi
+  done
+}
+
+# Prints the summed headless wall time in ms of one pass over the corpus.
+corpus_ms() {
+  total=0
+  for f in $(corpus "$2"); do
+    ms=$("$1" --headless --replay "$f" | sed -n 's/.* wall=\([0-9.]*\) ms.*/\1/p')
+    total=$(echo "$total $ms" | awk '{ printf "%.3f", $1 + $2 }')
+  done
+  echo "$total"
+}
+
+rm -rf "$OUT"
+mkdir -p "$PROFILE"
+
+echo "pgo: baseline build"
+$MAKE -s clean
+$MAKE -s $BINS
+for b in $BINS; do cp "$b" "$OUT/base_$b"; done
+
+echo "pgo: instrumented build"
+$MAKE -s clean
+$MAKE -s PGO=gen PGO_DIR="$PROFILE" $BINS
+for g in $GAMES; do
+  i=0
+  while [ "$i" -lt "$TRAIN_RUNS" ]; do
+    for f in $(corpus "$g"); do
+      "./${g}_console" --headless --replay "$f" > /dev/null
+    done
+    i=$((i + 1))
+  done
+done
+if ls "$PROFILE"/*.profraw > /dev/null 2>&1; then
+  PROFDATA=$(command -v llvm-profdata || echo "xcrun llvm-profdata")
+  $PROFDATA merge -o "$PROFILE/merged.profdata" "$PROFILE"/*.profraw
+fi
+
+echo "pgo: optimized build (PGO+LTO)"
+$MAKE -s clean
+$MAKE -s PGO=use LTO=1 PGO_DIR="$PROFILE" $BINS
+
+status=0
+for g in $GAMES; do
+  base=""
+  opt=""
+  i=0
+  while [ "$i" -lt "$ROUNDS" ]; do
+    b=$(corpus_ms "$OUT/base_${g}_console" "$g")
+    o=$(corpus_ms "./${g}_console" "$g")
+    base=$(echo "$base $b" | awk '{ m = $1; for (i = 2; i <= NF; i++) if ($i < m) m = $i; print m }')
+    opt=$(echo "$opt $o" | awk '{ m = $1; for (i = 2; i <= NF; i++) if ($i < m) m = $i; print m }')
+    i=$((i + 1))
+  done
+  for f in $(corpus "$g"); do
+    "./${g}_console" --headless --replay "$f" > /dev/null || status=1
+  done
+  echo "$g $base $opt" | awk '{ printf "pgo: %s_console corpus -O2 %.3f ms, PGO+LTO %.3f ms, speedup %.2fx\n", $1, $2, $3, ($3 > 0 ? $2 / $3 : 0) }'
+done
+exit $status
@@ -0,0 +1,373 @@
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bg_clock.h"
+#include "brick_game_api.h"
+#include "replay.h"
+
+extern int t_take_terminate(void);
+
+enum {
+  VERIFY_MAX_THREADS = 256,
+  VERIFY_DEFAULT_FRAMES = 1000
+};
+
+typedef struct {
+  char path[512];
+  Replay replay;
+  int frames;
+  int score;
+  int over;
+  int mismatched;
+  long long best_ns;
+  long long total_ns;
+} VerifyReplay;
+
+typedef struct {
+  int replay;
+  int frames;
+  int score;
+  int over;
+  long long ns;
+  long long cpu_ns;
+} VerifyTask;
+
+typedef struct {
+  int *tasks;
+  int count;
+  atomic_int next;
+} VerifyQueue;
+
+typedef struct {
+  int id;
+  long long cpu_ns;
+  int done;
+  int stolen;
+} VerifyWorker;
+
+static struct {
+  int threads;
+  int repeat;
+  VerifyReplay *replays;
+  int replay_count;
+  int skipped;
+  VerifyTask *tasks;
+  int task_count;
+  VerifyQueue queues[VERIFY_MAX_THREADS];
+  VerifyWorker workers[VERIFY_MAX_THREADS];
+} V;
+
+
+static void verify_usage(const char *prog) {
+  fprintf(stderr, "usage: %s [--threads N] [--repeat K] [DIR|FILE]...\n",
+          prog);
+}
+
+
+static int by_name(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+
+static void add_replay(const char *path) {
+  Replay r;
+  if (replay_load(path, &r) == 0) {
+    fprintf(stderr, "cannot read replay: %s\n", path);
+    V.skipped = V.skipped + 1;
+    return;
+  }
+  if (r.game[0] != 0 && strcmp(r.game, gameName()) != 0) {
+    replay_free(&r);
+    V.skipped = V.skipped + 1;
+    return;
+  }
+  VerifyReplay *grown = (VerifyReplay *)realloc(
+      V.replays, sizeof(VerifyReplay) * (size_t)(V.replay_count + 1));
+  if (grown == NULL) {
+    replay_free(&r);
+    return;
+  }
+  V.replays = grown;
+  VerifyReplay *v = &V.replays[V.replay_count];
+  memset(v, 0, sizeof(*v));
+  snprintf(v->path, sizeof(v->path), "%s", path);
+  v->replay = r;
+  if (v->replay.frames <= 0) v->replay.frames = VERIFY_DEFAULT_FRAMES;
+  V.replay_count = V.replay_count + 1;
+}
+
+
+static void add_path(const char *path) {
+  struct stat st;
+  if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+    add_replay(path);
+    return;
+  }
+  DIR *dir = opendir(path);
+  if (dir == NULL) return;
+  char **names = NULL;
+  int count = 0;
+  struct dirent *e = readdir(dir);
+  while (e != NULL) {
+    size_t len = strlen(e->d_name);
+    if (len > 4 && strcmp(e->d_name + len - 4, ".txt") == 0) {
+      char **grown = (char **)realloc(names, sizeof(char *) * (size_t)(count + 1));
+      if (grown != NULL) {
+        names = grown;
+        names[count] = strdup(e->d_name);
+        count = count + 1;
+      }
+    }
+    e = readdir(dir);
+  }
+  closedir(dir);
+  qsort(names, (size_t)count, sizeof(char *), by_name);
+  for (int i = 0; i < count; ++i) {
+    char full[512];
+    snprintf(full, sizeof(full), "%s/%s", path, names[i]);
+    add_replay(full);
+    free(names[i]);
+  }
+  free(names);
+}
+
+
+static long long thread_cpu_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+static int step_engine(void) {
+  GameInfo_t g = updateCurrentState();
+  int finished = isGameOver() != 0 || t_take_terminate() != 0;
+  int delay = bg_frame_delay_ms(finished, g.pause, g.speed);
+  freeGameInfo(&g);
+  bg_clock_advance_ns((long long)delay * 1000000LL);
+  return finished == 0;
+}
+
+
+static void run_task(VerifyTask *t) {
+  const Replay *r = &V.replays[t->replay].replay;
+  long long t0 = bg_clock_real_ns();
+  long long cpu0 = thread_cpu_ns();
+  GameInstance_t *game = gameCreate();
+  gameSelect(game);
+  setHighScorePersistence(0);
+  setRandomSeed(r->seed);
+  bg_clock_set_manual(1);
+
+  int step = 0;
+  int next = 0;
+  int running = 1;
+  while (running != 0 && step < r->frames) {
+    while (next < r->count && r->events[next].step <= step) {
+      userInput(r->events[next].action, r->events[next].hold != 0);
+      next = next + 1;
+    }
+    running = step_engine();
+    step = step + 1;
+  }
+  GameInfo_t g = updateCurrentState();
+  t->score = g.score;
+  freeGameInfo(&g);
+  t->over = isGameOver();
+  t->frames = step;
+
+  bg_clock_set_manual(0);
+  gameSelect(NULL);
+  gameDestroy(game);
+  t->ns = bg_clock_real_ns() - t0;
+  t->cpu_ns = thread_cpu_ns() - cpu0;
+}
+
+
+static int take_task(int queue) {
+  VerifyQueue *q = &V.queues[queue];
+  int i = atomic_fetch_add_explicit(&q->next, 1, memory_order_relaxed);
+  return i < q->count ? q->tasks[i] : -1;
+}
+
+
+static void *worker_main(void *arg) {
+  VerifyWorker *w = (VerifyWorker *)arg;
+  int victim = w->id;
+  int tried = 0;
+  while (tried < V.threads) {
+    int task = take_task(victim);
+    if (task < 0) {
+      victim = (victim + 1) % V.threads;
+      tried = tried + 1;
+      continue;
+    }
+    run_task(&V.tasks[task]);
+    w->cpu_ns += V.tasks[task].cpu_ns;
+    w->done = w->done + 1;
+    if (victim != w->id) w->stolen = w->stolen + 1;
+    tried = 0;
+  }
+  return NULL;
+}
+
+
+static int by_frames_desc(const void *a, const void *b) {
+  const VerifyTask *x = (const VerifyTask *)a;
+  const VerifyTask *y = (const VerifyTask *)b;
+  return V.replays[y->replay].replay.frames -
+         V.replays[x->replay].replay.frames;
+}
+
+
+static int build_tasks(void) {
+  V.task_count = V.replay_count * V.repeat;
+  V.tasks = (VerifyTask *)calloc((size_t)V.task_count, sizeof(VerifyTask));
+  if (V.tasks == NULL) return 0;
+  for (int i = 0; i < V.task_count; ++i) V.tasks[i].replay = i % V.replay_count;
+  qsort(V.tasks, (size_t)V.task_count, sizeof(VerifyTask), by_frames_desc);
+  for (int q = 0; q < V.threads; ++q) {
+    V.queues[q].tasks = (int *)calloc((size_t)V.task_count, sizeof(int));
+    if (V.queues[q].tasks == NULL) return 0;
+    V.queues[q].count = 0;
+    atomic_init(&V.queues[q].next, 0);
+  }
+  for (int i = 0; i < V.task_count; ++i) {
+    VerifyQueue *q = &V.queues[i % V.threads];
+    q->tasks[q->count] = i;
+    q->count = q->count + 1;
+  }
+  return 1;
+}
+
+
+static int collect(void) {
+  int failed = 0;
+  for (int i = 0; i < V.task_count; ++i) {
+    const VerifyTask *t = &V.tasks[i];
+    VerifyReplay *v = &V.replays[t->replay];
+    if (v->total_ns == 0) {
+      v->frames = t->frames;
+      v->score = t->score;
+      v->over = t->over;
+      v->best_ns = t->ns;
+    } else if (t->frames != v->frames || t->score != v->score ||
+               t->over != v->over) {
+      v->mismatched = 1;
+    }
+    if (t->ns < v->best_ns) v->best_ns = t->ns;
+    v->total_ns += t->ns > 0 ? t->ns : 1;
+  }
+  for (int i = 0; i < V.replay_count; ++i) {
+    VerifyReplay *v = &V.replays[i];
+    const Replay *r = &v->replay;
+    const char *verdict = "ok";
+    if (v->mismatched != 0) {
+      verdict = "NONDETERMINISTIC";
+      failed = 1;
+    } else if (r->has_end != 0 &&
+               (r->end_frames != v->frames || r->end_score != v->score ||
+                r->end_over != v->over)) {
+      verdict = "MISMATCH";
+      failed = 1;
+    } else if (r->has_end == 0) {
+      verdict = "ok (no end line)";
+    }
+    double ms = (double)v->best_ns / 1e6;
+    printf("  %-40s frames=%-6d score=%-5d over=%d %8.3f ms %10.0f frames/s  %s\n",
+           v->path, v->frames, v->score, v->over, ms,
+           ms > 0.0 ? v->frames / ms * 1000.0 : 0.0, verdict);
+    if (r->has_end != 0 && v->mismatched == 0 &&
+        (r->end_frames != v->frames || r->end_score != v->score ||
+         r->end_over != v->over)) {
+      printf("    expected end %d score %d over %d\n", r->end_frames,
+             r->end_score, r->end_over);
+    }
+  }
+  return failed;
+}
+
+
+int main(int argc, char **argv) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  V.threads = cores > 0 ? (int)cores : 1;
+  V.repeat = 3;
+  int paths = 0;
+  int i = 1;
+  while (i < argc) {
+    const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+    if (v != NULL && strcmp(argv[i], "--threads") == 0) {
+      V.threads = atoi(v);
+      i += 2;
+    } else if (v != NULL && strcmp(argv[i], "--repeat") == 0) {
+      V.repeat = atoi(v);
+      i += 2;
+    } else if (argv[i][0] == '-') {
+      verify_usage(argv[0]);
+      return 2;
+    } else {
+      add_path(argv[i]);
+      paths = paths + 1;
+      i += 1;
+    }
+  }
+  if (paths == 0) add_path("replays");
+  if (V.threads < 1) V.threads = 1;
+  if (V.threads > VERIFY_MAX_THREADS) V.threads = VERIFY_MAX_THREADS;
+  if (V.repeat < 1) V.repeat = 1;
+  if (V.replay_count == 0) {
+    fprintf(stderr, "no %s replays found\n", gameName());
+    return 2;
+  }
+  if (V.threads > V.replay_count * V.repeat) V.threads = V.replay_count * V.repeat;
+  if (build_tasks() == 0) return 2;
+
+  pthread_t threads[VERIFY_MAX_THREADS];
+  int started = 0;
+  long long t0 = bg_clock_real_ns();
+  for (int w = 0; w < V.threads; ++w) V.workers[w].id = w;
+  while (started < V.threads &&
+         pthread_create(&threads[started], NULL, worker_main,
+                        &V.workers[started]) == 0) {
+    started = started + 1;
+  }
+  if (started == 0) worker_main(&V.workers[0]);
+  for (int w = 0; w < started; ++w) pthread_join(threads[w], NULL);
+  long long wall_ns = bg_clock_real_ns() - t0;
+
+  printf("replay_verify game=%s replays=%d skipped=%d repeat=%d threads=%d\n",
+         gameName(), V.replay_count, V.skipped, V.repeat,
+         started > 0 ? started : 1);
+  int failed = collect();
+
+  long long frames = 0;
+  long long cpu_ns = 0;
+  int stolen = 0;
+  for (int t = 0; t < V.task_count; ++t) frames += V.tasks[t].frames;
+  for (int w = 0; w < V.threads; ++w) {
+    cpu_ns += V.workers[w].cpu_ns;
+    stolen += V.workers[w].stolen;
+  }
+  double wall_ms = (double)wall_ns / 1e6;
+  printf("aggregate: %lld frames in %.3f ms, %.0f frames/s, %.2fx cpu/wall, "
+         "%d of %d tasks stolen\n",
+         frames, wall_ms, wall_ms > 0.0 ? frames / wall_ms * 1000.0 : 0.0,
+         wall_ns > 0 ? (double)cpu_ns / (double)wall_ns : 0.0, stolen,
+         V.task_count);
+
+  for (int r = 0; r < V.replay_count; ++r) replay_free(&V.replays[r].replay);
+  for (int q = 0; q < V.threads; ++q) free(V.queues[q].tasks);
+  free(V.replays);
+  free(V.tasks);
+  return failed;
+}
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <vector>
+
+#include "brick_game_api.h"
+#include "engine_bench.h"
+#include "snake.h"
+
+struct SnakeBenchAccess {
+  static void Layout(snake::SnakeGame& g, int length) {
+    const int w = g.width_;
+    const int h = g.height_;
+    g.body_.clear();
+    g.occupied_.assign(static_cast<size_t>(w) * h, 0);
+    for (int i = 0; i < length; ++i) {
+      const int line = i / w;
+      const int x = line % 2 == 0 ? i % w : w - 1 - i % w;
+      const snake::Point p{x, h - 1 - line};
+      g.body_.push_front(p);
+      g.SetOccupied(p, true);
+    }
+    g.current_direction_ = snake::Direction::kUp;
+    g.pending_turn_ = snake::TurnRequest::kNone;
+    g.game_over_ = false;
+    g.terminate_requested_ = false;
+    g.food_ = snake::Point{0, 0};
+    g.fsm_state_ = snake::STATE_INPUT;
+    g.ClearChanges();
+  }
+
+  static bool Collides(const snake::SnakeGame& g, const snake::Point& p) {
+    return g.DetectCollisionAt(p, false);
+  }
+
+  static int SpawnFrom(snake::SnakeGame& g, const snake::Point& from) {
+    g.food_ = from;
+    g.SpawnFoodNext();
+    g.changes_.clear();
+    return g.food_.x;
+  }
+};
+
+namespace {
+
+struct SnakeFixture {
+  snake::SnakeGame game;
+  int length = 4;
+  std::vector<snake::Point> probes;
+};
+
+
+void BuildProbes(SnakeFixture& f) {
+  const int w = f.game.Width();
+  const int h = f.game.Height();
+  unsigned rng = 0x2545F491u;
+  f.probes.resize(1024);
+  for (snake::Point& p : f.probes) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    p.x = static_cast<int>(rng % static_cast<unsigned>(w));
+    p.y = h - 1 - static_cast<int>((rng >> 12) % static_cast<unsigned>(h / 2));
+  }
+}
+
+
+void ResetLayout(void* ctx) {
+  SnakeFixture& f = *static_cast<SnakeFixture*>(ctx);
+  SnakeBenchAccess::Layout(f.game, f.length);
+}
+
+
+void RunCollision(void* ctx, long long iters) {
+  SnakeFixture& f = *static_cast<SnakeFixture*>(ctx);
+  long long hits = 0;
+  for (long long i = 0; i < iters; ++i) {
+    hits += SnakeBenchAccess::Collides(f.game, f.probes[i & 1023]);
+  }
+  bench_keep(hits);
+}
+
+
+void RunSpawnFood(void* ctx, long long iters) {
+  SnakeFixture& f = *static_cast<SnakeFixture*>(ctx);
+  long long sum = 0;
+  for (long long i = 0; i < iters; ++i) {
+    sum += SnakeBenchAccess::SpawnFrom(f.game, f.probes[i & 1023]);
+  }
+  bench_keep(sum);
+}
+
+
+void RunStep(void* ctx, long long iters) {
+  SnakeFixture& f = *static_cast<SnakeFixture*>(ctx);
+  for (long long i = 0; i < iters; ++i) {
+    f.game.ClickAccelerate();
+    f.game.Step();
+  }
+  bench_keep(f.game.Body().front().y);
+}
+
+
+struct ApiFixture {
+  GameInstance_t* game = nullptr;
+};
+
+
+void ResetApi(void* ctx) {
+  ApiFixture& f = *static_cast<ApiFixture*>(ctx);
+  gameSelect(f.game);
+  resetGame();
+  GameInfo_t g = updateCurrentState();
+  freeGameInfo(&g);
+}
+
+
+void RunUpdate(void* ctx, long long iters) {
+  (void)ctx;
+  long long sum = 0;
+  for (long long i = 0; i < iters; ++i) {
+    userInput(Action, false);
+    GameInfo_t g = updateCurrentState();
+    sum += g.field[0][0] + g.score;
+    freeGameInfo(&g);
+  }
+  bench_keep(sum);
+}
+
+
+void BenchEngine(int side, int length) {
+  SnakeFixture f;
+  f.game.SetHighScorePersistence(false);
+  f.game.Init(side, side);
+  f.length = length;
+  BuildProbes(f);
+  ResetLayout(&f);
+  const BenchParam params[] = {{"board", side}, {"body", length}};
+  bench_case("snake.DetectCollisionAt", params, 2, nullptr, RunCollision, &f,
+             1LL << 30);
+  bench_case("snake.SpawnFoodNext", params, 2, ResetLayout, RunSpawnFood, &f,
+             1LL << 30);
+  const int rows_ahead = side - 1 - (length - 1) / side;
+  if (rows_ahead > 1) {
+    bench_case("snake.Step", params, 2, ResetLayout, RunStep, &f,
+               3LL * (rows_ahead - 1));
+  }
+}
+
+
+void BenchApi(int side) {
+  ApiFixture f;
+  f.game = gameCreate();
+  gameSelect(f.game);
+  setHighScorePersistence(0);
+  if (setFieldSize(side, side)) {
+    const BenchParam params[] = {{"board", side}};
+    bench_case("snake.updateCurrentState", params, 1, ResetApi, RunUpdate, &f,
+               3LL * (side / 2 - 2));
+  }
+  gameSelect(nullptr);
+  gameDestroy(f.game);
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  if (!bench_begin("snake", argc, argv)) return 2;
+  const int sides[] = {32, 256, 1024};
+  const int lengths[] = {4, 64, 1024, 16384, 262144};
+  for (int side : sides) {
+    for (int length : lengths) {
+      if (length <= side * side / 2) BenchEngine(side, length);
+    }
+  }
+  for (int side : sides) {
+    if (side <= 256) BenchEngine(side, side * side - 2);
+  }
+  for (int side : sides) BenchApi(side);
+  return bench_end();
+}
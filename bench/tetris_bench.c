@@ -0,0 +1,186 @@
+#include <string.h>
+
+#include "engine_bench.h"
+#include "tetris.h"
+
+enum { PIECES = 7 };
+
+typedef struct {
+  GameInstance_t *game;
+  int filled;
+  int full;
+  int board[T_ROWS * T_COLS];
+  Active pieces[PIECES];
+  Active probe;
+} TetrisFixture;
+
+
+static void build_board(TetrisFixture *f) {
+  memset(f->board, 0, sizeof(f->board));
+  int r = 0;
+  while (r < f->filled) {
+    int row = T_ROWS - 1 - r;
+    int hole = r < f->full ? -1 : (r * 7 + 3) % T_COLS;
+    int c = 0;
+    while (c < T_COLS) {
+      f->board[row * T_COLS + c] = c != hole;
+      c++;
+    }
+    r++;
+  }
+}
+
+
+static void restore_board(void *ctx) {
+  TetrisFixture *f = ctx;
+  gameSelect(f->game);
+  memcpy(t_board_cells(), f->board, sizeof(f->board));
+  t_set_active(&f->probe);
+}
+
+
+static void prepare(TetrisFixture *f) {
+  gameSelect(f->game);
+  setRandomSeed(1);
+  t_init();
+  int i = 0;
+  while (i < PIECES) {
+    t_spawn_new_piece();
+    f->pieces[i] = *t_active();
+    i++;
+  }
+  build_board(f);
+  f->probe = f->pieces[1];
+  f->probe.y = T_ROWS - f->filled - 4;
+  if (f->probe.y < -1) f->probe.y = -1;
+  restore_board(f);
+}
+
+
+static void run_can_move(void *ctx, long long iters) {
+  (void)ctx;
+  long long ok = 0;
+  long long i = 0;
+  while (i < iters) {
+    ok += t_can_move((int)(i % 3) - 1, (int)(i & 1));
+    i++;
+  }
+  bench_keep(ok);
+}
+
+
+static void run_rotate(void *ctx, long long iters) {
+  (void)ctx;
+  long long i = 0;
+  while (i < iters) {
+    t_rotate_cw();
+    i++;
+  }
+  bench_keep(t_active()->shape.m[1][1]);
+}
+
+
+static void run_hard_drop(void *ctx, long long iters) {
+  TetrisFixture *f = ctx;
+  long long depth = 0;
+  long long i = 0;
+  while (i < iters) {
+    t_set_active(&f->pieces[i % PIECES]);
+    t_hard_drop();
+    depth += t_active()->y;
+    i++;
+  }
+  bench_keep(depth);
+}
+
+
+static void run_restore(void *ctx, long long iters) {
+  TetrisFixture *f = ctx;
+  long long i = 0;
+  while (i < iters) {
+    memcpy(t_board_cells(), f->board, sizeof(f->board));
+    i++;
+  }
+  bench_keep(t_board_cells()[T_ROWS * T_COLS - 1]);
+}
+
+
+static void run_clear_lines(void *ctx, long long iters) {
+  TetrisFixture *f = ctx;
+  long long cleared = 0;
+  long long i = 0;
+  while (i < iters) {
+    memcpy(t_board_cells(), f->board, sizeof(f->board));
+    cleared += t_clear_full_lines();
+    i++;
+  }
+  bench_keep(cleared);
+}
+
+
+static void reset_game(void *ctx) {
+  TetrisFixture *f = ctx;
+  gameSelect(f->game);
+  setRandomSeed(1);
+  GameInfo_t g = updateCurrentState();
+  freeGameInfo(&g);
+  memcpy(t_board_cells(), f->board, sizeof(f->board));
+}
+
+
+static void run_update(void *ctx, long long iters) {
+  (void)ctx;
+  long long sum = 0;
+  long long i = 0;
+  while (i < iters) {
+    GameInfo_t g = updateCurrentState();
+    sum += g.field[T_ROWS - 1][0] + g.score;
+    freeGameInfo(&g);
+    i++;
+  }
+  bench_keep(sum);
+}
+
+
+int main(int argc, char **argv) {
+  if (!bench_begin("tetris", argc, argv)) return 2;
+  TetrisFixture f;
+  memset(&f, 0, sizeof(f));
+  f.game = gameCreate();
+  gameSelect(f.game);
+  setHighScorePersistence(0);
+
+  const long long cap = 1LL << 30;
+  int filled = 0;
+  while (filled <= T_ROWS - 2) {
+    f.filled = filled;
+    f.full = 0;
+    prepare(&f);
+    BenchParam p[] = {{"filled_rows", filled}};
+    bench_case("tetris.t_can_move", p, 1, restore_board, run_can_move, &f,
+               cap);
+    bench_case("tetris.t_rotate_cw", p, 1, restore_board, run_rotate, &f, cap);
+    bench_case("tetris.t_hard_drop", p, 1, restore_board, run_hard_drop, &f,
+               cap);
+    bench_case("tetris.updateCurrentState", p, 1, reset_game, run_update, &f,
+               cap);
+    filled += filled < 16 ? 4 : 2;
+  }
+
+  int full = 0;
+  while (full <= 4) {
+    f.filled = 16;
+    f.full = full;
+    prepare(&f);
+    BenchParam p[] = {{"filled_rows", 16}, {"full_rows", full}};
+    bench_case("tetris.board_restore", p, 2, restore_board, run_restore, &f,
+               cap);
+    bench_case("tetris.t_clear_full_lines", p, 2, restore_board,
+               run_clear_lines, &f, cap);
+    full += full < 2 ? 1 : 2;
+  }
+
+  gameSelect(NULL);
+  gameDestroy(f.game);
+  return bench_end();
+}
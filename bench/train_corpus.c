@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bg_clock.h"
+#include "brick_game_api.h"
+#include "replay.h"
+#include "train_player.h"
+
+static struct {
+  unsigned seed;
+  int frames;
+  double noise;
+  const char *out;
+} T;
+
+
+static void train_usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s --seed U --out FILE [--frames N] [--noise X]\n", prog);
+}
+
+
+static int train_options(int argc, char **argv) {
+  T.seed = 1;
+  T.frames = 8000;
+  int i = 1;
+  while (i < argc) {
+    const char *a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+    if (v == NULL) {
+      train_usage(argv[0]);
+      return 0;
+    }
+    if (strcmp(a, "--seed") == 0) {
+      T.seed = (unsigned)strtoul(v, NULL, 0);
+    } else if (strcmp(a, "--frames") == 0) {
+      T.frames = atoi(v);
+    } else if (strcmp(a, "--noise") == 0) {
+      T.noise = atof(v);
+    } else if (strcmp(a, "--out") == 0) {
+      T.out = v;
+    } else {
+      train_usage(argv[0]);
+      return 0;
+    }
+    i += 2;
+  }
+  if (T.out == NULL || T.frames < 1) {
+    train_usage(argv[0]);
+    return 0;
+  }
+  return 1;
+}
+
+
+int main(int argc, char **argv) {
+  if (train_options(argc, argv) == 0) return 2;
+
+  Replay r;
+  memset(&r, 0, sizeof(r));
+  snprintf(r.game, sizeof(r.game), "%s", gameName());
+  r.seed = T.seed;
+  setHighScorePersistence(0);
+  setRandomSeed(T.seed);
+  bg_clock_set_manual(1);
+  train_player_init(T.seed, T.noise);
+  userInput(Start, false);
+  replay_append(&r, 0, Start, 0);
+
+  int step = 0;
+  int over = 0;
+  while (over == 0 && step < T.frames) {
+    GameInfo_t g = updateCurrentState();
+    over = isGameOver();
+    step = step + 1;
+    UserAction_t action = Start;
+    if (over == 0 && train_player_act(&g, &action) != 0) {
+      userInput(action, false);
+      replay_append(&r, step, action, 0);
+    }
+    bg_clock_advance_ns((long long)bg_frame_delay_ms(over, g.pause, g.speed) *
+                        1000000LL);
+    freeGameInfo(&g);
+  }
+
+  GameInfo_t g = updateCurrentState();
+  r.frames = step;
+  r.has_end = 1;
+  r.end_frames = step;
+  r.end_score = g.score;
+  r.end_over = isGameOver();
+  freeGameInfo(&g);
+  int ok = replay_save(T.out, &r);
+  printf("train_corpus game=%s seed=%u frames=%d score=%d over=%d events=%d\n",
+         gameName(), T.seed, r.end_frames, r.end_score, r.end_over, r.count);
+  replay_free(&r);
+  if (ok == 0) {
+    fprintf(stderr, "cannot write %s\n", T.out);
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef TRAIN_PLAYER_H_
+#define TRAIN_PLAYER_H_
+
+#include "brick_game_api.h"
+
+void train_player_init(unsigned seed, double noise);
+int train_player_act(const GameInfo_t *g, UserAction_t *action);
+
+#endif
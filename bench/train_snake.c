@@ -0,0 +1,72 @@
+#include <stdlib.h>
+
+#include "train_player.h"
+
+static const int DX[4] = {0, 1, 0, -1};
+static const int DY[4] = {-1, 0, 1, 0};
+
+static struct {
+  unsigned rng;
+  int rows;
+  int cols;
+  int head_row;
+  int head_col;
+  int dir;
+} P;
+
+
+void train_player_init(unsigned seed, double noise) {
+  (void)noise;
+  P.rng = seed * 2654435761u + 1;
+  getFieldSize(&P.rows, &P.cols);
+  P.head_row = -1;
+  P.head_col = -1;
+  P.dir = 1;
+}
+
+
+static int free_cell(const GameInfo_t *g, int r, int c) {
+  return r >= 0 && r < P.rows && c >= 0 && c < P.cols && g->field[r][c] != 1;
+}
+
+
+int train_player_act(const GameInfo_t *g, UserAction_t *action) {
+  int row = 0, col = 0;
+  getFocusCell(&row, &col);
+  if (row == P.head_row && col == P.head_col) return 0;
+  for (int d = 0; d < 4 && P.head_row >= 0; ++d) {
+    if (row - P.head_row == DY[d] && col - P.head_col == DX[d]) P.dir = d;
+  }
+  P.head_row = row;
+  P.head_col = col;
+
+  int food_row = -1, food_col = -1;
+  for (int r = 0; r < P.rows; ++r) {
+    for (int c = 0; c < P.cols; ++c) {
+      if (g->field[r][c] == 2) {
+        food_row = r;
+        food_col = c;
+      }
+    }
+  }
+  const int turns[3] = {P.dir, (P.dir + 3) % 4, (P.dir + 1) % 4};
+  int best = -1;
+  int best_dist = 1 << 30;
+  for (int k = 0; k < 3; ++k) {
+    int r = row + DY[turns[k]];
+    int c = col + DX[turns[k]];
+    if (free_cell(g, r, c) == 0) continue;
+    int dist = abs(r - food_row) + abs(c - food_col);
+    P.rng ^= P.rng << 13;
+    P.rng ^= P.rng >> 17;
+    P.rng ^= P.rng << 5;
+    if (P.rng % 16 == 0) dist -= 1;
+    if (dist < best_dist) {
+      best_dist = dist;
+      best = k;
+    }
+  }
+  if (best == 1) *action = Left;
+  if (best == 2) *action = Right;
+  return best == 1 || best == 2;
+}
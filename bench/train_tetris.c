@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "tetris.h"
+#include "train_player.h"
+
+enum { TRAIN_NO_PLAN = -100, TRAIN_MAX_WAIT = 12 };
+
+static struct {
+  unsigned rng;
+  double noise;
+  int target_rot;
+  int target_x;
+  int planned_y;
+  int rotated;
+  int wait;
+  Shape last;
+} P;
+
+
+void train_player_init(unsigned seed, double noise) {
+  memset(&P, 0, sizeof(P));
+  P.rng = seed * 2654435761u + 1;
+  P.noise = noise;
+  P.planned_y = TRAIN_NO_PLAN;
+}
+
+
+static double train_jitter(void) {
+  P.rng ^= P.rng << 13;
+  P.rng ^= P.rng >> 17;
+  P.rng ^= P.rng << 5;
+  return P.noise * (double)(P.rng % 1000) / 1000.0;
+}
+
+
+static Shape rotate_cw(Shape s) {
+  Shape out;
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < 4; ++c) out.m[r][c] = s.m[3 - c][r];
+  }
+  return out;
+}
+
+
+static int fits(const int *board, const Shape *s, int x, int y) {
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      if (s->m[r][c] == 0) continue;
+      int row = y + r, col = x + c;
+      if (col < 0 || col >= T_COLS || row >= T_ROWS) return 0;
+      if (row >= 0 && board[row * T_COLS + col] != 0) return 0;
+    }
+  }
+  return 1;
+}
+
+
+static double evaluate(const int *board0, const Shape *s, int x, int y) {
+  if (fits(board0, s, x, y) == 0) return -1e9;
+  while (fits(board0, s, x, y + 1) != 0) y++;
+  int board[T_ROWS * T_COLS];
+  memcpy(board, board0, sizeof(board));
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      if (s->m[r][c] != 0 && y + r >= 0) board[(y + r) * T_COLS + x + c] = 1;
+    }
+  }
+  int lines = 0, holes = 0, height = 0, bumps = 0, prev = -1;
+  for (int r = 0; r < T_ROWS; ++r) {
+    int full = 1;
+    for (int c = 0; c < T_COLS; ++c) full &= board[r * T_COLS + c] != 0;
+    lines += full;
+  }
+  for (int c = 0; c < T_COLS; ++c) {
+    int h = 0, seen = 0;
+    for (int r = 0; r < T_ROWS; ++r) {
+      if (board[r * T_COLS + c] != 0) {
+        if (seen == 0) h = T_ROWS - r;
+        seen = 1;
+      } else if (seen != 0) {
+        holes++;
+      }
+    }
+    height += h;
+    if (prev >= 0) bumps += abs(h - prev);
+    prev = h;
+  }
+  return lines * 0.76 - height * 0.51 - holes * 0.36 - bumps * 0.18;
+}
+
+
+static void plan(const Active *a) {
+  double best = -1e18;
+  Shape s = a->shape;
+  for (int k = 0; k < 4; ++k) {
+    for (int x = -3; x < T_COLS; ++x) {
+      double v = evaluate(t_board_cells(), &s, x, a->y) + train_jitter();
+      if (v > best) {
+        best = v;
+        P.target_rot = k;
+        P.target_x = x;
+      }
+    }
+    s = rotate_cw(s);
+  }
+  P.rotated = 0;
+  P.wait = 0;
+}
+
+
+int train_player_act(const GameInfo_t *g, UserAction_t *action) {
+  (void)g;
+  TetrisState state = t_get_state();
+  if (state != STATE_INPUT && state != STATE_DROP) return 0;
+  const Active *a = t_active();
+  int new_piece = memcmp(&P.last, &a->shape, sizeof(P.last)) != 0;
+  if (a->y < P.planned_y || P.planned_y == TRAIN_NO_PLAN ||
+      (new_piece != 0 && P.rotated == 0)) {
+    plan(a);
+  }
+  P.planned_y = a->y;
+  *action = Action;
+  if (P.rotated < P.target_rot) {
+    *action = Up;
+    P.rotated++;
+  } else if (a->x < P.target_x) {
+    *action = Right;
+  } else if (a->x > P.target_x) {
+    *action = Left;
+  }
+  P.wait++;
+  if (P.wait > TRAIN_MAX_WAIT) *action = Action;
+  if (*action == Action) {
+    P.planned_y = TRAIN_NO_PLAN;
+    P.rotated = 0;
+  }
+  P.last = a->shape;
+  return 1;
+}
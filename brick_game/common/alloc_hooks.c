@@ -0,0 +1,49 @@
+#include <errno.h>
+#include <stddef.h>
+
+#include "alloc_track.h"
+
+#if defined(__GLIBC__)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+
+int alloc_hooks_linked(void) { return 1; }
+
+
+void *malloc(size_t size) {
+  alloc_track_note(size);
+  return __libc_malloc(size);
+}
+
+
+void *calloc(size_t count, size_t size) {
+  alloc_track_note(count * size);
+  return __libc_calloc(count, size);
+}
+
+
+void *realloc(void *ptr, size_t size) {
+  alloc_track_note(size);
+  return __libc_realloc(ptr, size);
+}
+
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  alloc_track_note(size);
+  return __libc_memalign(alignment, size);
+}
+
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+  if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+  alloc_track_note(size);
+  void *p = __libc_memalign(alignment, size);
+  if (p == 0) return ENOMEM;
+  *out = p;
+  return 0;
+}
+#endif
@@ -0,0 +1,61 @@
+#include "alloc_track.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+static atomic_int track_on = 0;
+static atomic_ullong track_count = 0;
+static atomic_ullong track_bytes = 0;
+static _Thread_local AllocScope *track_scope = 0;
+
+
+__attribute__((weak)) int alloc_hooks_linked(void) { return 0; }
+
+
+int alloc_track_available(void) { return alloc_hooks_linked(); }
+
+
+void alloc_track_enable(int on) { atomic_store(&track_on, on != 0); }
+
+
+int alloc_track_enabled(void) { return atomic_load(&track_on); }
+
+
+unsigned long long alloc_track_count(void) {
+  return atomic_load_explicit(&track_count, memory_order_relaxed);
+}
+
+
+unsigned long long alloc_track_bytes(void) {
+  return atomic_load_explicit(&track_bytes, memory_order_relaxed);
+}
+
+
+void alloc_scope_begin(AllocScope *scope) {
+  scope->count = 0;
+  scope->bytes = 0;
+  scope->outer = track_scope;
+  track_scope = scope;
+}
+
+
+void alloc_scope_end(AllocScope *scope) {
+  AllocScope **link = &track_scope;
+  while (*link != 0 && *link != scope) link = &(*link)->outer;
+  if (*link == scope) *link = scope->outer;
+  scope->outer = 0;
+}
+
+
+void alloc_track_note(size_t size) {
+  AllocScope *scope = track_scope;
+  while (scope != 0) {
+    scope->count = scope->count + 1;
+    scope->bytes = scope->bytes + size;
+    scope = scope->outer;
+  }
+  if (atomic_load_explicit(&track_on, memory_order_relaxed) == 0) return;
+  atomic_fetch_add_explicit(&track_count, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&track_bytes, size, memory_order_relaxed);
+}
@@ -0,0 +1,31 @@
+#ifndef ALLOC_TRACK_H_
+#define ALLOC_TRACK_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct AllocScope {
+  unsigned long long count;
+  unsigned long long bytes;
+  struct AllocScope *outer;
+} AllocScope;
+
+int alloc_track_available(void);
+void alloc_track_enable(int on);
+int alloc_track_enabled(void);
+unsigned long long alloc_track_count(void);
+unsigned long long alloc_track_bytes(void);
+
+void alloc_scope_begin(AllocScope *scope);
+void alloc_scope_end(AllocScope *scope);
+
+void alloc_track_note(size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
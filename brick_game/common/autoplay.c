@@ -0,0 +1,52 @@
+#include "autoplay.h"
+
+#include <stddef.h>
+
+static const unsigned AUTOPLAY_SEED = 0x9E3779B9u;
+
+
+static void autoplay_new_game(AutoPlayer *p) {
+  p->game = gameCreate();
+  gameSelect(p->game);
+  setHighScorePersistence(0);
+}
+
+
+int autoplay_open(AutoPlayer *p, int index) {
+  unsigned seed = AUTOPLAY_SEED * (unsigned)(index + 1);
+  seed = seed * 1664525u + 1013904223u;
+  p->rng = (seed ^ (seed >> 16)) | 1u;
+  autoplay_new_game(p);
+  return p->game != NULL;
+}
+
+
+void autoplay_close(AutoPlayer *p) {
+  gameDestroy(p->game);
+  p->game = NULL;
+}
+
+
+void autoplay_drive(AutoPlayer *p) {
+  p->rng ^= p->rng << 13;
+  p->rng ^= p->rng >> 17;
+  p->rng ^= p->rng << 5;
+  unsigned roll = p->rng % 24u;
+  if (roll == 0) {
+    userInput(Left, false);
+  } else if (roll == 1) {
+    userInput(Right, false);
+  } else if (roll == 2) {
+    userInput(Up, false);
+  }
+}
+
+
+int autoplay_restart_if_over(AutoPlayer *p) {
+  int over = isGameOver() != 0;
+  if (over != 0) {
+    autoplay_close(p);
+    autoplay_new_game(p);
+  }
+  return over;
+}
@@ -0,0 +1,24 @@
+#ifndef AUTOPLAY_H_
+#define AUTOPLAY_H_
+
+#include "brick_game_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  GameInstance_t *game;
+  unsigned rng;
+} AutoPlayer;
+
+int autoplay_open(AutoPlayer *p, int index);
+void autoplay_close(AutoPlayer *p);
+void autoplay_drive(AutoPlayer *p);
+int autoplay_restart_if_over(AutoPlayer *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
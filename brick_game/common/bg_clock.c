@@ -0,0 +1,42 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bg_clock.h"
+
+#include <time.h>
+
+static _Thread_local int manual_clock = 0;
+static _Thread_local long long manual_ns = 0;
+
+
+long long bg_clock_real_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+long long bg_clock_now_ns(void) {
+  if (manual_clock != 0) return manual_ns;
+  return bg_clock_real_ns();
+}
+
+
+void bg_clock_set_manual(int on) {
+  manual_clock = on != 0;
+  manual_ns = 1000000000LL;
+}
+
+
+void bg_clock_advance_ns(long long ns) {
+  if (ns > 0) manual_ns += ns;
+}
+
+
+int bg_frame_delay_ms(int finished, int paused, int speed_ms) {
+  int delay = BG_FRAME_GAME_OVER_MS;
+  if (finished == 0) {
+    delay = paused != 0 ? BG_FRAME_PAUSE_MS : speed_ms;
+    if (delay < 1) delay = 1;
+  }
+  return delay;
+}
@@ -0,0 +1,20 @@
+#ifndef BG_CLOCK_H_
+#define BG_CLOCK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum { BG_FRAME_GAME_OVER_MS = 800, BG_FRAME_PAUSE_MS = 50 };
+
+long long bg_clock_now_ns(void);
+long long bg_clock_real_ns(void);
+void bg_clock_set_manual(int on);
+void bg_clock_advance_ns(long long ns);
+int bg_frame_delay_ms(int finished, int paused, int speed_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+#include "fsm_stats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bg_clock.h"
+
+#ifdef BG_FSM_STATS
+long long fsm_stats_fallback_ticks(void) { return bg_clock_real_ns(); }
+
+
+static double ns_per_tick(void) {
+  static double cached = 0.0;
+  if (cached > 0.0) return cached;
+  long long t0 = bg_clock_real_ns();
+  unsigned long long k0 = fsm_stats_ticks();
+  long long t1 = t0;
+  while (t1 - t0 < 5000000) t1 = bg_clock_real_ns();
+  unsigned long long k1 = fsm_stats_ticks();
+  cached = k1 > k0 ? (double)(t1 - t0) / (double)(k1 - k0) : 1.0;
+  return cached;
+}
+#endif
+
+
+void fsm_stats_export(const FsmCounters *c, const char *const *names,
+                      int states, FsmStats_t *out) {
+  memset(out, 0, sizeof(*out));
+#ifdef BG_FSM_STATS
+  if (c == NULL) return;
+  if (states > FSM_STATS_MAX_STATES) states = FSM_STATS_MAX_STATES;
+  out->enabled = 1;
+  out->states = states;
+  out->ns_per_tick = ns_per_tick();
+  int i = 0;
+  while (i < states) {
+    out->names[i] = names[i];
+    out->calls[i] = c->calls[i];
+    out->ticks[i] = c->ticks[i];
+    memcpy(out->transitions[i], c->transitions[i], sizeof(out->transitions[i]));
+    i++;
+  }
+#else
+  (void)c;
+  (void)names;
+  (void)states;
+#endif
+}
+
+
+int fsm_stats_write(const FsmStats_t *s, const char *game, const char *path) {
+  if (s->enabled == 0) return 0;
+  FILE *f = fopen(path, "w");
+  if (f == NULL) return 0;
+  fprintf(f, "fsm-stats game %s ns_per_tick %.6f\n", game, s->ns_per_tick);
+  int i = 0;
+  while (i < s->states) {
+    double ns = (double)s->ticks[i] * s->ns_per_tick;
+    double mean = s->calls[i] ? ns / (double)s->calls[i] : 0.0;
+    fprintf(f, "state %s calls %llu total_ns %.0f mean_ns %.1f\n", s->names[i],
+            s->calls[i], ns, mean);
+    i++;
+  }
+  i = 0;
+  while (i < s->states) {
+    int j = 0;
+    while (j < s->states) {
+      if (s->transitions[i][j] != 0) {
+        fprintf(f, "transition %s %s %llu\n", s->names[i], s->names[j],
+                s->transitions[i][j]);
+      }
+      j++;
+    }
+    i++;
+  }
+  return fclose(f) == 0;
+}
@@ -0,0 +1,63 @@
+#ifndef FSM_STATS_H_
+#define FSM_STATS_H_
+
+#include "brick_game_api.h"
+
+#if defined(BG_FSM_STATS) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  unsigned long long calls[FSM_STATS_MAX_STATES];
+  unsigned long long ticks[FSM_STATS_MAX_STATES];
+  unsigned long long transitions[FSM_STATS_MAX_STATES][FSM_STATS_MAX_STATES];
+} FsmCounters;
+
+void fsm_stats_export(const FsmCounters *c, const char *const *names,
+                      int states, FsmStats_t *out);
+int fsm_stats_write(const FsmStats_t *s, const char *game, const char *path);
+
+#ifdef BG_FSM_STATS
+
+long long fsm_stats_fallback_ticks(void);
+
+static inline unsigned long long fsm_stats_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return (unsigned long long)fsm_stats_fallback_ticks();
+#endif
+}
+
+
+static inline void fsm_stats_record(FsmCounters *c, int from, int to,
+                                    unsigned long long ticks) {
+  c->calls[from] += 1;
+  c->ticks[from] += ticks;
+  c->transitions[from][to] += 1;
+}
+
+#define FSM_STATS_BEGIN() unsigned long long fsm_stats_t0_ = fsm_stats_ticks()
+#define FSM_STATS_END(c, from, to) \
+  fsm_stats_record((c), (from), (to), fsm_stats_ticks() - fsm_stats_t0_)
+
+#else
+
+#define FSM_STATS_BEGIN() \
+  do {                    \
+  } while (0)
+#define FSM_STATS_END(c, from, to) \
+  do {                             \
+  } while (0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
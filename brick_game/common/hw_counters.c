@@ -0,0 +1,132 @@
+#define _GNU_SOURCE
+
+#include "hw_counters.h"
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char *const HW_NAMES[HW_COUNTER_COUNT] = {
+    "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses"};
+
+
+const char *hw_counter_name(HwCounter which) {
+  return which < HW_COUNTER_COUNT ? HW_NAMES[which] : "?";
+}
+
+#if defined(__linux__)
+static const struct {
+  unsigned type;
+  unsigned long long config;
+} HW_EVENTS[HW_COUNTER_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE,
+     PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+};
+
+
+static int open_event(int which) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = HW_EVENTS[which].type;
+  attr.config = HW_EVENTS[which].config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+
+int hw_counters_open(HwCounters *c) {
+  int opened = 0;
+  c->error = 0;
+  for (int i = 0; i < HW_COUNTER_COUNT; ++i) {
+    c->fd[i] = open_event(i);
+    if (c->fd[i] >= 0) {
+      opened = opened + 1;
+    } else if (c->error == 0) {
+      c->error = errno;
+    }
+  }
+  return opened;
+}
+
+
+void hw_counters_close(HwCounters *c) {
+  for (int i = 0; i < HW_COUNTER_COUNT; ++i) {
+    if (c->fd[i] >= 0) close(c->fd[i]);
+    c->fd[i] = -1;
+  }
+}
+
+
+void hw_counters_start(HwCounters *c) {
+  for (int i = 0; i < HW_COUNTER_COUNT; ++i) {
+    if (c->fd[i] < 0) continue;
+    ioctl(c->fd[i], PERF_EVENT_IOC_RESET, 0);
+    ioctl(c->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+
+void hw_counters_stop(HwCounters *c, HwSample *acc) {
+  for (int i = 0; i < HW_COUNTER_COUNT; ++i) {
+    if (c->fd[i] >= 0) ioctl(c->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+  }
+  for (int i = 0; i < HW_COUNTER_COUNT; ++i) {
+    unsigned long long v[3];
+    if (c->fd[i] < 0 || read(c->fd[i], v, sizeof(v)) != sizeof(v)) continue;
+    if (v[2] == 0) continue;
+    double scaled = (double)v[0];
+    if (v[2] < v[1]) scaled = scaled * (double)v[1] / (double)v[2];
+    acc->value[i] += scaled;
+    acc->valid |= 1u << i;
+  }
+}
+#else
+int hw_counters_open(HwCounters *c) {
+  for (int i = 0; i < HW_COUNTER_COUNT; ++i) c->fd[i] = -1;
+  c->error = ENOSYS;
+  return 0;
+}
+
+
+void hw_counters_close(HwCounters *c) { (void)c; }
+
+
+void hw_counters_start(HwCounters *c) { (void)c; }
+
+
+void hw_counters_stop(HwCounters *c, HwSample *acc) {
+  (void)c;
+  (void)acc;
+}
+#endif
+
+
+void hw_sample_print(const HwSample *s, double per, const char *unit,
+                     FILE *out) {
+  if (per <= 0.0) per = 1.0;
+  if ((s->valid & (1u << HW_CYCLES)) != 0 &&
+      (s->valid & (1u << HW_INSTRUCTIONS)) != 0 && s->value[HW_CYCLES] > 0.0) {
+    fprintf(out, " ipc=%.2f",
+            s->value[HW_INSTRUCTIONS] / s->value[HW_CYCLES]);
+  }
+  for (int i = 0; i < HW_COUNTER_COUNT; ++i) {
+    if ((s->valid & (1u << i)) == 0) continue;
+    fprintf(out, " %s/%s=%.1f", HW_NAMES[i], unit, s->value[i] / per);
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef HW_COUNTERS_H_
+#define HW_COUNTERS_H_
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  HW_CYCLES = 0,
+  HW_INSTRUCTIONS,
+  HW_BRANCH_MISSES,
+  HW_L1D_MISSES,
+  HW_LLC_MISSES,
+  HW_COUNTER_COUNT
+} HwCounter;
+
+typedef struct {
+  int fd[HW_COUNTER_COUNT];
+  int error;
+} HwCounters;
+
+typedef struct {
+  double value[HW_COUNTER_COUNT];
+  unsigned valid;
+} HwSample;
+
+int hw_counters_open(HwCounters *c);
+void hw_counters_close(HwCounters *c);
+void hw_counters_start(HwCounters *c);
+void hw_counters_stop(HwCounters *c, HwSample *acc);
+
+const char *hw_counter_name(HwCounter which);
+void hw_sample_print(const HwSample *s, double per, const char *unit,
+                     FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "latency.h"
+
+#include <signal.h>
+#include <string.h>
+
+static volatile sig_atomic_t dump_requested = 0;
+
+
+static int bucket_of(unsigned long long v) {
+  const unsigned long long sub = 1ULL << LATENCY_SUB_BITS;
+  if (v < sub) return (int)v;
+  int msb = 63 - __builtin_clzll(v);
+  int shift = msb - LATENCY_SUB_BITS;
+  int idx = (shift + 1) * (int)sub + (int)((v >> shift) & (sub - 1));
+  return idx < LATENCY_BUCKETS ? idx : LATENCY_BUCKETS - 1;
+}
+
+
+static long long bucket_top(int idx) {
+  const int sub = 1 << LATENCY_SUB_BITS;
+  if (idx < sub) return idx;
+  int shift = idx / sub - 1;
+  long long base = (long long)(sub + idx % sub) << shift;
+  return base + (1LL << shift) - 1;
+}
+
+
+void latency_reset(LatencyHist *h) { memset(h, 0, sizeof(*h)); }
+
+
+void latency_record(LatencyHist *h, long long ns) {
+  if (ns < 0) ns = 0;
+  if (h->total == 0 || ns < h->min_ns) h->min_ns = ns;
+  if (ns > h->max_ns) h->max_ns = ns;
+  h->counts[bucket_of((unsigned long long)ns)] += 1;
+  h->total += 1;
+}
+
+
+long long latency_percentile(const LatencyHist *h, double p) {
+  if (h->total == 0) return 0;
+  unsigned long long rank = (unsigned long long)(p * (double)h->total + 0.5);
+  if (rank < 1) rank = 1;
+  if (rank > h->total) rank = h->total;
+  unsigned long long seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+    seen += h->counts[i];
+    if (seen >= rank) {
+      long long top = bucket_top(i);
+      return top < h->max_ns ? top : h->max_ns;
+    }
+  }
+  return h->max_ns;
+}
+
+
+void latency_print(const LatencyHist *h, const char *label, FILE *out) {
+  fprintf(out,
+          "%s n=%llu p50=%.2f p90=%.2f p99=%.2f max=%.2f min=%.2f ms\n", label,
+          h->total, latency_percentile(h, 0.50) / 1e6,
+          latency_percentile(h, 0.90) / 1e6, latency_percentile(h, 0.99) / 1e6,
+          h->max_ns / 1e6, h->min_ns / 1e6);
+  fflush(out);
+}
+
+
+static void on_dump_signal(int sig) {
+  (void)sig;
+  dump_requested = 1;
+}
+
+
+void latency_watch_signal(void) {
+#ifdef SIGUSR1
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_dump_signal;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &sa, 0);
+#endif
+}
+
+
+int latency_take_request(void) {
+  int requested = dump_requested != 0;
+  dump_requested = 0;
+  return requested;
+}
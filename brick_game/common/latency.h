@@ -0,0 +1,31 @@
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum { LATENCY_SUB_BITS = 4, LATENCY_BUCKETS = 61 << LATENCY_SUB_BITS };
+
+typedef struct {
+  unsigned long long counts[LATENCY_BUCKETS];
+  unsigned long long total;
+  long long min_ns;
+  long long max_ns;
+} LatencyHist;
+
+void latency_reset(LatencyHist *h);
+void latency_record(LatencyHist *h, long long ns);
+long long latency_percentile(const LatencyHist *h, double p);
+void latency_print(const LatencyHist *h, const char *label, FILE *out);
+
+void latency_watch_signal(void);
+int latency_take_request(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+#include "perf_meter.h"
+
+#include <string.h>
+
+#include "alloc_track.h"
+#include "bg_clock.h"
+#include "sim.h"
+
+static const long long PERF_WINDOW_NS = 500000000LL;
+
+
+static void perf_window_open(PerfMeter *m) {
+  SimStats s;
+  sim_stats(&s);
+  m->t0_ns = bg_clock_real_ns();
+  m->steps0 = s.steps;
+  m->ticks0 = s.ticks;
+  m->allocs0 = alloc_track_count();
+  m->frames = 0;
+  m->bytes = 0;
+  m->frame_ns = 0;
+}
+
+
+void perf_meter_start(PerfMeter *m) {
+  memset(m, 0, sizeof(*m));
+  alloc_track_enable(1);
+  perf_window_open(m);
+}
+
+
+void perf_meter_stop(PerfMeter *m) {
+  (void)m;
+  alloc_track_enable(0);
+}
+
+
+int perf_meter_frame(PerfMeter *m, long long frame_ns,
+                     unsigned long long bytes, int speed_ms) {
+  m->frames += 1;
+  m->bytes += bytes;
+  m->frame_ns += frame_ns;
+  if (speed_ms > 0) m->speed_ms = speed_ms;
+  long long now = bg_clock_real_ns();
+  long long span = now - m->t0_ns;
+  if (span < PERF_WINDOW_NS) return 0;
+
+  SimStats s;
+  sim_stats(&s);
+  double secs = (double)span / 1e9;
+  double frames = (double)m->frames;
+  PerfSnapshot *p = &m->shown;
+  p->frame_ms = (double)m->frame_ns / frames / 1e6;
+  p->tick_hz = (double)(s.ticks - m->ticks0) / secs;
+  p->target_hz = m->speed_ms > 0 ? 1000.0 / (double)m->speed_ms : 0.0;
+  p->steps_per_s = (double)(s.steps - m->steps0) / secs;
+  p->allocs_per_frame = (double)(alloc_track_count() - m->allocs0) / frames;
+  p->bytes_per_frame = (double)m->bytes / frames;
+  p->input_depth = s.input_depth;
+  perf_window_open(m);
+  return 1;
+}
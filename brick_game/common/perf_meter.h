@@ -0,0 +1,39 @@
+#ifndef PERF_METER_H_
+#define PERF_METER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  double frame_ms;
+  double tick_hz;
+  double target_hz;
+  double steps_per_s;
+  double allocs_per_frame;
+  double bytes_per_frame;
+  int input_depth;
+} PerfSnapshot;
+
+typedef struct {
+  long long t0_ns;
+  unsigned long long steps0;
+  unsigned long long ticks0;
+  unsigned long long allocs0;
+  unsigned long long frames;
+  unsigned long long bytes;
+  long long frame_ns;
+  int speed_ms;
+  PerfSnapshot shown;
+} PerfMeter;
+
+void perf_meter_start(PerfMeter *m);
+void perf_meter_stop(PerfMeter *m);
+int perf_meter_frame(PerfMeter *m, long long frame_ns,
+                     unsigned long long bytes, int speed_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+#include "replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const ACTION_NAMES[] = {
+    "Start", "Pause", "Terminate", "Left", "Right", "Up", "Down", "Action"};
+
+enum { ACTION_COUNT = (int)(sizeof(ACTION_NAMES) / sizeof(ACTION_NAMES[0])) };
+
+
+const char *replay_action_name(UserAction_t action) {
+  int i = (int)action;
+  return i >= 0 && i < ACTION_COUNT ? ACTION_NAMES[i] : "?";
+}
+
+
+int replay_parse_action(const char *name, UserAction_t *out) {
+  for (int i = 0; i < ACTION_COUNT; ++i) {
+    if (strcmp(name, ACTION_NAMES[i]) == 0) {
+      *out = (UserAction_t)i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+int replay_append(Replay *r, int step, UserAction_t action, int hold) {
+  if (r->count == r->cap) {
+    int cap = r->cap ? r->cap * 2 : 64;
+    ReplayEvent *grown =
+        (ReplayEvent *)realloc(r->events, sizeof(ReplayEvent) * (size_t)cap);
+    if (grown == 0) return 0;
+    r->events = grown;
+    r->cap = cap;
+  }
+  r->events[r->count].step = step;
+  r->events[r->count].action = action;
+  r->events[r->count].hold = hold != 0;
+  r->count = r->count + 1;
+  return 1;
+}
+
+
+void replay_free(Replay *r) {
+  free(r->events);
+  memset(r, 0, sizeof(*r));
+}
+
+
+static int parse_line(Replay *r, const char *line) {
+  int known = line[0] == '#' || line[0] == '\n' ||
+              strncmp(line, "brickgame-replay", 16) == 0 ||
+              sscanf(line, "game %15s", r->game) == 1 ||
+              sscanf(line, "seed %u", &r->seed) == 1 ||
+              sscanf(line, "frames %d", &r->frames) == 1;
+  if (known == 0 && sscanf(line, "end %d score %d over %d", &r->end_frames,
+                           &r->end_score, &r->end_over) == 3) {
+    r->has_end = 1;
+    known = 1;
+  }
+  int ok = 1;
+  if (known == 0) {
+    char word[32];
+    char extra[32];
+    int step = 0;
+    UserAction_t action = Start;
+    int n = sscanf(line, "%d %31s %31s", &step, word, extra);
+    ok = n >= 2 && step >= 0 && replay_parse_action(word, &action);
+    if (ok != 0) {
+      ok = replay_append(r, step, action, n == 3 && strcmp(extra, "hold") == 0);
+    }
+  }
+  return ok;
+}
+
+
+int replay_load(const char *path, Replay *r) {
+  memset(r, 0, sizeof(*r));
+  FILE *f = fopen(path, "r");
+  if (f == 0) return 0;
+  char line[256];
+  int ok = 1;
+  int last = 0;
+  while (ok != 0 && fgets(line, sizeof(line), f) != 0) {
+    ok = parse_line(r, line);
+    if (ok != 0 && r->count > 0) {
+      ok = r->events[r->count - 1].step >= last;
+      last = r->events[r->count - 1].step;
+    }
+  }
+  fclose(f);
+  if (ok == 0) replay_free(r);
+  return ok;
+}
+
+
+int replay_save(const char *path, const Replay *r) {
+  FILE *f = fopen(path, "w");
+  if (f == 0) return 0;
+  fprintf(f, "brickgame-replay 1\n");
+  fprintf(f, "game %s\n", r->game);
+  fprintf(f, "seed %u\n", r->seed);
+  if (r->frames > 0) fprintf(f, "frames %d\n", r->frames);
+  for (int i = 0; i < r->count; ++i) {
+    const ReplayEvent *e = &r->events[i];
+    fprintf(f, "%d %s%s\n", e->step, replay_action_name(e->action),
+            e->hold ? " hold" : "");
+  }
+  if (r->has_end) {
+    fprintf(f, "end %d score %d over %d\n", r->end_frames, r->end_score,
+            r->end_over);
+  }
+  return fclose(f) == 0;
+}
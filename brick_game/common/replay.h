@@ -0,0 +1,40 @@
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include "brick_game_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  int step;
+  UserAction_t action;
+  int hold;
+} ReplayEvent;
+
+typedef struct {
+  char game[16];
+  unsigned seed;
+  int frames;
+  ReplayEvent *events;
+  int count;
+  int cap;
+  int has_end;
+  int end_frames;
+  int end_score;
+  int end_over;
+} Replay;
+
+int replay_load(const char *path, Replay *r);
+int replay_save(const char *path, const Replay *r);
+int replay_append(Replay *r, int step, UserAction_t action, int hold);
+void replay_free(Replay *r);
+const char *replay_action_name(UserAction_t action);
+int replay_parse_action(const char *name, UserAction_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,488 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sim.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+
+#include "bg_clock.h"
+#include "trace.h"
+
+extern int t_take_terminate(void);
+
+enum { SIM_SLOTS = 3, SIM_RING = 256, SIM_FRESH = 4, SIM_INDEX = 3 };
+
+static const long long SIM_INPUT_EXPIRE_NS = 1000000000LL;
+
+typedef struct {
+  UserAction_t action;
+  int hold;
+  long long t_ns;
+} SimInput;
+
+typedef struct {
+  int rd;
+  int wr;
+} SimSignal;
+
+typedef struct {
+  int fd;
+  long long deadline_ns;
+} SimTimer;
+
+typedef struct {
+  SimFrame slots[SIM_SLOTS];
+  atomic_uint middle;
+  unsigned back;
+  unsigned front;
+  unsigned long long seq;
+
+  SimInput ring[SIM_RING];
+  atomic_uint ring_head;
+  atomic_uint ring_tail;
+
+  long long pending_input_ns;
+  unsigned long long pending_digest;
+  long long input_ns;
+  unsigned input_id;
+  int published;
+
+  SimSignal wake;
+  SimSignal frame_ready;
+  SimTimer timer;
+
+  atomic_ullong steps;
+  atomic_ullong ticks;
+
+  atomic_int running;
+  pthread_t thread;
+} SimState;
+
+static SimState *sim_state(void) {
+  static SimState s = {.wake = {-1, -1},
+                       .frame_ready = {-1, -1},
+                       .timer = {-1, -1}};
+  return &s;
+}
+#define SIM (*sim_state())
+
+
+static int signal_open(SimSignal *sig) {
+#ifdef __linux__
+  sig->rd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  sig->wr = sig->rd;
+  return sig->rd >= 0;
+#else
+  int fds[2];
+  if (pipe(fds) != 0) return 0;
+  for (int i = 0; i < 2; ++i) {
+    fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+  }
+  sig->rd = fds[0];
+  sig->wr = fds[1];
+  return 1;
+#endif
+}
+
+
+static void signal_close(SimSignal *sig) {
+  if (sig->rd >= 0) close(sig->rd);
+  if (sig->wr >= 0 && sig->wr != sig->rd) close(sig->wr);
+  sig->rd = -1;
+  sig->wr = -1;
+}
+
+
+static void signal_raise(SimSignal *sig) {
+  uint64_t one = 1;
+  ssize_t n = write(sig->wr, &one, sizeof(one));
+  (void)n;
+}
+
+
+static void signal_drain(SimSignal *sig) {
+  uint64_t buf[8];
+  while (read(sig->rd, buf, sizeof(buf)) > 0) {
+  }
+}
+
+
+static int timer_open(SimTimer *t) {
+  t->deadline_ns = -1;
+#ifdef __linux__
+  t->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  return t->fd >= 0;
+#else
+  t->fd = -1;
+  return 1;
+#endif
+}
+
+
+static void timer_close(SimTimer *t) {
+  if (t->fd >= 0) close(t->fd);
+  t->fd = -1;
+}
+
+
+static void timer_arm(SimTimer *t, long long deadline_ns) {
+  t->deadline_ns = deadline_ns;
+#ifdef __linux__
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  if (deadline_ns >= 0) {
+    its.it_value.tv_sec = (time_t)(deadline_ns / 1000000000LL);
+    its.it_value.tv_nsec = (long)(deadline_ns % 1000000000LL);
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+      its.it_value.tv_nsec = 1;
+    }
+  }
+  timerfd_settime(t->fd, TFD_TIMER_ABSTIME, &its, 0);
+#endif
+}
+
+
+static int timer_poll_timeout_ms(const SimTimer *t) {
+  int timeout = -1;
+#ifndef __linux__
+  if (t->deadline_ns >= 0) {
+    long long left = t->deadline_ns - bg_clock_now_ns();
+    timeout = left <= 0 ? 0 : (int)((left + 999999LL) / 1000000LL);
+  }
+#else
+  (void)t;
+#endif
+  return timeout;
+}
+
+
+static int timer_expired(SimTimer *t) {
+  if (t->deadline_ns < 0) return 0;
+#ifdef __linux__
+  uint64_t ticks = 0;
+  if (read(t->fd, &ticks, sizeof(ticks)) != (ssize_t)sizeof(ticks)) return 0;
+  return ticks > 0;
+#else
+  return bg_clock_now_ns() >= t->deadline_ns;
+#endif
+}
+
+
+static void frame_release(SimFrame *f) {
+  free(f->cells);
+  free(f->field);
+  free(f->row_version);
+  memset(f, 0, sizeof(*f));
+}
+
+
+static int frame_reserve(SimFrame *f, int rows, int cols) {
+  if (f->rows == rows && f->cols == cols && f->cells != 0) return 1;
+  free(f->cells);
+  free(f->field);
+  free(f->row_version);
+  f->cells = (int *)calloc((size_t)rows * (size_t)cols, sizeof(int));
+  f->field = (int **)malloc(sizeof(int *) * (size_t)rows);
+  f->row_version = (unsigned *)calloc((size_t)rows, sizeof(unsigned));
+  if (f->cells == 0 || f->field == 0 || f->row_version == 0) {
+    frame_release(f);
+    return 0;
+  }
+  for (int r = 0; r < rows; ++r) {
+    f->field[r] = f->cells + (size_t)r * (size_t)cols;
+  }
+  f->rows = rows;
+  f->cols = cols;
+  return 1;
+}
+
+
+static void frame_fill(SimFrame *f, const GameInfo_t *g) {
+  int rows = 0, cols = 0;
+  getFieldSize(&rows, &cols);
+  if (frame_reserve(f, rows, cols) && g->field != 0) {
+    const unsigned *versions = getFieldRowVersions();
+    for (int r = 0; r < rows; ++r) {
+      if (versions != 0) {
+        if (f->row_version[r] == versions[r]) continue;
+        f->row_version[r] = versions[r];
+      } else {
+        f->row_version[r] = (unsigned)(SIM.seq + 1);
+      }
+      memcpy(f->field[r], g->field[r], sizeof(int) * (size_t)cols);
+    }
+  }
+  for (int r = 0; r < 4; ++r) {
+    f->next[r] = f->next_cells + r * 4;
+    for (int c = 0; c < 4; ++c) {
+      f->next[r][c] = g->next != 0 ? g->next[r][c] : 0;
+    }
+  }
+  f->score = g->score;
+  f->high_score = g->high_score;
+  f->level = g->level;
+  f->speed = g->speed;
+  f->pause = g->pause;
+}
+
+
+static unsigned long long frame_digest(const SimFrame *f) {
+  unsigned long long h = 1469598103934665603ULL;
+  const unsigned *versions = getFieldRowVersions();
+  for (int r = 0; r < f->rows; ++r) {
+    if (versions != 0) {
+      h = (h ^ f->row_version[r]) * 1099511628211ULL;
+      continue;
+    }
+    for (int c = 0; c < f->cols; ++c) {
+      h = (h ^ (unsigned)f->field[r][c]) * 1099511628211ULL;
+    }
+  }
+  for (int i = 0; i < 16; ++i) {
+    h = (h ^ (unsigned)f->next_cells[i]) * 1099511628211ULL;
+  }
+  int hud[5] = {f->score, f->level, f->speed, f->pause, f->game_over};
+  for (int i = 0; i < 5; ++i) h = (h ^ (unsigned)hud[i]) * 1099511628211ULL;
+  return h;
+}
+
+
+static const SimFrame *last_published(void) {
+  if (SIM.published == 0) return 0;
+  unsigned long long best = 0;
+  const SimFrame *f = 0;
+  for (int i = 0; i < SIM_SLOTS; ++i) {
+    if ((unsigned)i != SIM.back && SIM.slots[i].seq > best) {
+      best = SIM.slots[i].seq;
+      f = &SIM.slots[i];
+    }
+  }
+  return f;
+}
+
+
+static void note_input(long long t_ns) {
+  if (SIM.pending_input_ns != 0) return;
+  const SimFrame *shown = last_published();
+  SIM.pending_input_ns = t_ns != 0 ? t_ns : 1;
+  SIM.pending_digest = shown != 0 ? frame_digest(shown) : 0;
+}
+
+
+static void attribute_input(SimFrame *f) {
+  if (SIM.pending_input_ns != 0) {
+    if (frame_digest(f) != SIM.pending_digest) {
+      SIM.input_ns = SIM.pending_input_ns;
+      SIM.input_id = SIM.input_id + 1;
+      SIM.pending_input_ns = 0;
+    } else if (bg_clock_now_ns() - SIM.pending_input_ns >
+               SIM_INPUT_EXPIRE_NS) {
+      SIM.pending_input_ns = 0;
+    }
+  }
+  f->input_ns = SIM.input_ns;
+  f->input_id = SIM.input_id;
+}
+
+
+static void sim_publish(void) {
+  SIM.slots[SIM.back].seq = ++SIM.seq;
+  unsigned prev = atomic_exchange(&SIM.middle, SIM.back | SIM_FRESH);
+  SIM.back = prev & SIM_INDEX;
+  SIM.published = 1;
+}
+
+
+static void sim_drain_inputs(void) {
+  unsigned tail = atomic_load_explicit(&SIM.ring_tail, memory_order_relaxed);
+  unsigned head = atomic_load_explicit(&SIM.ring_head, memory_order_acquire);
+  while (tail != head) {
+    const SimInput *in = &SIM.ring[tail % SIM_RING];
+    int release = in->hold == 0 && (in->action == Action || in->action == Down);
+    if (release == 0) note_input(in->t_ns);
+    userInput(in->action, in->hold != 0);
+    tail = tail + 1;
+  }
+  atomic_store_explicit(&SIM.ring_tail, tail, memory_order_release);
+}
+
+
+static int sim_step_once(void) {
+  atomic_fetch_add_explicit(&SIM.steps, 1, memory_order_relaxed);
+  sim_drain_inputs();
+  GameInfo_t g = updateCurrentState();
+  SimFrame *f = &SIM.slots[SIM.back];
+  frame_fill(f, &g);
+  f->game_over = isGameOver();
+  f->terminated = t_take_terminate();
+  getMotionHint(&f->motion);
+  getFocusCell(&f->focus_row, &f->focus_col);
+  attribute_input(f);
+  int period = g.speed;
+  if (period < 1) period = 1;
+  if (g.pause != 0 || f->game_over != 0) period = -1;
+  freeGameInfo(&g);
+  sim_publish();
+  signal_raise(&SIM.frame_ready);
+  return period;
+}
+
+
+static void sim_schedule(int period_ms, int due) {
+  if (due != 0) atomic_fetch_add_explicit(&SIM.ticks, 1, memory_order_relaxed);
+  long long now = bg_clock_now_ns();
+  if (period_ms < 0) {
+    timer_arm(&SIM.timer, -1);
+  } else if (due != 0 || SIM.timer.deadline_ns < 0) {
+    long long base = SIM.timer.deadline_ns < 0 ? now : SIM.timer.deadline_ns;
+    long long deadline = base + (long long)period_ms * 1000000LL;
+    if (deadline < now) deadline = now;
+    timer_arm(&SIM.timer, deadline);
+  }
+}
+
+
+static int sim_has_input(void) {
+  unsigned tail = atomic_load_explicit(&SIM.ring_tail, memory_order_relaxed);
+  unsigned head = atomic_load_explicit(&SIM.ring_head, memory_order_acquire);
+  return head != tail;
+}
+
+
+static void *sim_thread_main(void *arg) {
+  (void)arg;
+  trace_thread_name("sim");
+  sim_schedule(sim_step_once(), 1);
+  while (atomic_load(&SIM.running) != 0) {
+    struct pollfd fds[2];
+    int nfds = 1;
+    fds[0].fd = SIM.wake.rd;
+    fds[0].events = POLLIN;
+    if (SIM.timer.fd >= 0) {
+      fds[1].fd = SIM.timer.fd;
+      fds[1].events = POLLIN;
+      nfds = 2;
+    }
+    trace_begin("sim_wait");
+    poll(fds, (nfds_t)nfds, timer_poll_timeout_ms(&SIM.timer));
+    trace_end("sim_wait");
+    if (atomic_load(&SIM.running) == 0) break;
+
+    signal_drain(&SIM.wake);
+    int due = timer_expired(&SIM.timer);
+    if (due != 0 || sim_has_input() != 0) {
+      sim_schedule(sim_step_once(), due);
+    }
+  }
+  return 0;
+}
+
+
+int sim_start(void) {
+  if (atomic_load(&SIM.running) != 0) return 1;
+  SIM.back = 0;
+  SIM.published = 0;
+  SIM.pending_input_ns = 0;
+  atomic_store(&SIM.middle, 1u);
+  SIM.front = 2;
+  atomic_store(&SIM.ring_head, 0u);
+  atomic_store(&SIM.ring_tail, 0u);
+  if (signal_open(&SIM.wake) == 0) return 0;
+  if (signal_open(&SIM.frame_ready) == 0 || timer_open(&SIM.timer) == 0) {
+    signal_close(&SIM.wake);
+    signal_close(&SIM.frame_ready);
+    return 0;
+  }
+  atomic_store(&SIM.running, 1);
+  if (pthread_create(&SIM.thread, 0, sim_thread_main, 0) != 0) {
+    atomic_store(&SIM.running, 0);
+    signal_close(&SIM.wake);
+    signal_close(&SIM.frame_ready);
+    timer_close(&SIM.timer);
+    return 0;
+  }
+  return 1;
+}
+
+
+void sim_stop(void) {
+  if (atomic_exchange(&SIM.running, 0) == 0) return;
+  signal_raise(&SIM.wake);
+  pthread_join(SIM.thread, 0);
+  signal_close(&SIM.wake);
+  signal_close(&SIM.frame_ready);
+  timer_close(&SIM.timer);
+  for (int i = 0; i < SIM_SLOTS; ++i) {
+    frame_release(&SIM.slots[i]);
+  }
+}
+
+
+int sim_frame_fd(void) { return SIM.frame_ready.rd; }
+
+
+int sim_post_input(UserAction_t action, bool hold) {
+  return sim_post_input_at(action, hold, bg_clock_now_ns());
+}
+
+
+int sim_post_input_at(UserAction_t action, bool hold, long long t_ns) {
+  unsigned head = atomic_load_explicit(&SIM.ring_head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&SIM.ring_tail, memory_order_acquire);
+  if (head - tail >= SIM_RING) return 0;
+  SIM.ring[head % SIM_RING].action = action;
+  SIM.ring[head % SIM_RING].hold = hold ? 1 : 0;
+  SIM.ring[head % SIM_RING].t_ns = t_ns;
+  atomic_store_explicit(&SIM.ring_head, head + 1, memory_order_release);
+  if (SIM.wake.wr >= 0) signal_raise(&SIM.wake);
+  return 1;
+}
+
+
+const SimFrame *sim_latest(void) {
+  if (SIM.frame_ready.rd >= 0) signal_drain(&SIM.frame_ready);
+  if (atomic_load(&SIM.middle) & SIM_FRESH) {
+    unsigned prev = atomic_exchange(&SIM.middle, SIM.front);
+    SIM.front = prev & SIM_INDEX;
+  }
+  const SimFrame *f = &SIM.slots[SIM.front];
+  return f->seq != 0 ? f : 0;
+}
+
+
+GameInfo_t sim_frame_info(const SimFrame *f) {
+  GameInfo_t g;
+  memset(&g, 0, sizeof(g));
+  if (f != 0) {
+    g.field = f->field;
+    g.next = (int **)f->next;
+    g.score = f->score;
+    g.high_score = f->high_score;
+    g.level = f->level;
+    g.speed = f->speed;
+    g.pause = f->pause;
+  }
+  return g;
+}
+
+
+void sim_stats(SimStats *out) {
+  unsigned tail = atomic_load_explicit(&SIM.ring_tail, memory_order_acquire);
+  unsigned head = atomic_load_explicit(&SIM.ring_head, memory_order_acquire);
+  out->steps = atomic_load_explicit(&SIM.steps, memory_order_relaxed);
+  out->ticks = atomic_load_explicit(&SIM.ticks, memory_order_relaxed);
+  out->input_depth = (int)(head - tail);
+}
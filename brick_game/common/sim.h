@@ -0,0 +1,52 @@
+#ifndef SIM_H_
+#define SIM_H_
+
+#include "brick_game_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  unsigned long long seq;
+  int rows;
+  int cols;
+  int *cells;
+  int **field;
+  unsigned *row_version;
+  int next_cells[16];
+  int *next[4];
+  int score;
+  int high_score;
+  int level;
+  int speed;
+  int pause;
+  int game_over;
+  int terminated;
+  int focus_row;
+  int focus_col;
+  long long input_ns;
+  unsigned input_id;
+  MotionHint_t motion;
+} SimFrame;
+
+typedef struct {
+  unsigned long long steps;
+  unsigned long long ticks;
+  int input_depth;
+} SimStats;
+
+int sim_start(void);
+void sim_stop(void);
+int sim_frame_fd(void);
+int sim_post_input(UserAction_t action, bool hold);
+int sim_post_input_at(UserAction_t action, bool hold, long long t_ns);
+const SimFrame *sim_latest(void);
+GameInfo_t sim_frame_info(const SimFrame *f);
+void sim_stats(SimStats *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,185 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bg_clock.h"
+
+enum { TRACE_RING = 1 << 14, TRACE_THREADS = 64, TRACE_FLUSH_MS = 10 };
+
+typedef struct {
+  const char *name;
+  long long t_ns;
+  char phase;
+} TraceEvent;
+
+typedef struct {
+  TraceEvent events[TRACE_RING];
+  atomic_uint head;
+  atomic_uint tail;
+  _Atomic(const char *) thread_name;
+  int named;
+  int tid;
+} TraceRing;
+
+typedef struct {
+  atomic_int on;
+  atomic_int running;
+  atomic_int count;
+  _Atomic(TraceRing *) rings[TRACE_THREADS];
+  atomic_ullong dropped;
+  FILE *out;
+  pthread_t thread;
+  long long t0_ns;
+  int first;
+} Tracer;
+
+static Tracer TR;
+static _Thread_local TraceRing *local_ring = NULL;
+static _Thread_local int local_full = 0;
+
+
+static TraceRing *trace_ring(void) {
+  if (local_ring != NULL || local_full != 0) return local_ring;
+  int idx = atomic_fetch_add(&TR.count, 1);
+  if (idx >= TRACE_THREADS) {
+    local_full = 1;
+    return NULL;
+  }
+  TraceRing *ring = (TraceRing *)calloc(1, sizeof(TraceRing));
+  if (ring == NULL) {
+    local_full = 1;
+    return NULL;
+  }
+  ring->tid = idx + 1;
+  atomic_store_explicit(&TR.rings[idx], ring, memory_order_release);
+  local_ring = ring;
+  return ring;
+}
+
+
+static void trace_push(const char *name, char phase) {
+  if (atomic_load_explicit(&TR.on, memory_order_relaxed) == 0) return;
+  TraceRing *ring = trace_ring();
+  if (ring == NULL) return;
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head - tail >= TRACE_RING) {
+    atomic_fetch_add_explicit(&TR.dropped, 1, memory_order_relaxed);
+    return;
+  }
+  TraceEvent *e = &ring->events[head & (TRACE_RING - 1)];
+  e->name = name;
+  e->t_ns = bg_clock_real_ns();
+  e->phase = phase;
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+
+void trace_begin(const char *name) { trace_push(name, 'B'); }
+
+
+void trace_end(const char *name) { trace_push(name, 'E'); }
+
+
+void trace_thread_name(const char *name) {
+  if (atomic_load_explicit(&TR.on, memory_order_relaxed) == 0) return;
+  TraceRing *ring = trace_ring();
+  if (ring != NULL) atomic_store(&ring->thread_name, name);
+}
+
+
+int trace_active(void) { return atomic_load(&TR.on) != 0; }
+
+
+unsigned long long trace_dropped(void) { return atomic_load(&TR.dropped); }
+
+
+static void trace_separator(void) {
+  fputs(TR.first ? "\n" : ",\n", TR.out);
+  TR.first = 0;
+}
+
+
+static void trace_drain(TraceRing *ring) {
+  const char *thread_name = atomic_load(&ring->thread_name);
+  if (ring->named == 0 && thread_name != NULL) {
+    trace_separator();
+    fprintf(TR.out,
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}",
+            ring->tid, thread_name);
+    ring->named = 1;
+  }
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  while (tail != head) {
+    const TraceEvent *e = &ring->events[tail & (TRACE_RING - 1)];
+    trace_separator();
+    fprintf(TR.out,
+            "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+            e->name, e->phase, (double)(e->t_ns - TR.t0_ns) / 1000.0,
+            ring->tid);
+    tail = tail + 1;
+  }
+  atomic_store_explicit(&ring->tail, tail, memory_order_release);
+}
+
+
+static void trace_drain_all(void) {
+  int count = atomic_load(&TR.count);
+  if (count > TRACE_THREADS) count = TRACE_THREADS;
+  for (int i = 0; i < count; ++i) {
+    TraceRing *ring =
+        atomic_load_explicit(&TR.rings[i], memory_order_acquire);
+    if (ring != NULL) trace_drain(ring);
+  }
+  fflush(TR.out);
+}
+
+
+static void *trace_thread_main(void *arg) {
+  (void)arg;
+  while (atomic_load(&TR.running) != 0) {
+    poll(0, 0, TRACE_FLUSH_MS);
+    trace_drain_all();
+  }
+  return 0;
+}
+
+
+int trace_start(const char *path) {
+  if (TR.out != NULL) return 0;
+  TR.out = fopen(path, "w");
+  if (TR.out == NULL) return 0;
+  TR.t0_ns = bg_clock_real_ns();
+  TR.first = 1;
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", TR.out);
+  atomic_store(&TR.running, 1);
+  if (pthread_create(&TR.thread, 0, trace_thread_main, 0) != 0) {
+    atomic_store(&TR.running, 0);
+    fclose(TR.out);
+    TR.out = NULL;
+    return 0;
+  }
+  atomic_store(&TR.on, 1);
+  return 1;
+}
+
+
+void trace_stop(void) {
+  if (TR.out == NULL) return;
+  atomic_store(&TR.on, 0);
+  atomic_store(&TR.running, 0);
+  pthread_join(TR.thread, 0);
+  trace_drain_all();
+  fputs("\n]}\n", TR.out);
+  fclose(TR.out);
+  TR.out = NULL;
+}
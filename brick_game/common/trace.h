@@ -0,0 +1,20 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int trace_start(const char *path);
+void trace_stop(void);
+int trace_active(void);
+void trace_begin(const char *name);
+void trace_end(const char *name);
+void trace_thread_name(const char *name);
+unsigned long long trace_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -28,10 +28,60 @@ typedef struct {
   int pause;
 } GameInfo_t;
 
+typedef enum { MotionSlide, MotionGrow, MotionShrink } MotionKind_t;
+
+typedef struct {
+  int row;
+  int col;
+  int dr;
+  int dc;
+  MotionKind_t kind;
+} MotionCell_t;
+
+enum { MOTION_MAX_CELLS = 4 };
+
+typedef struct {
+  long long clock_ns;
+  double interval_ms;
+  double progress;
+  int count;
+  MotionCell_t cells[MOTION_MAX_CELLS];
+} MotionHint_t;
+
+enum { FSM_STATS_MAX_STATES = 8 };
+
+typedef struct {
+  int enabled;
+  int states;
+  const char *names[FSM_STATS_MAX_STATES];
+  unsigned long long calls[FSM_STATS_MAX_STATES];
+  unsigned long long ticks[FSM_STATS_MAX_STATES];
+  unsigned long long transitions[FSM_STATS_MAX_STATES][FSM_STATS_MAX_STATES];
+  double ns_per_tick;
+} FsmStats_t;
+
+typedef struct GameInstance GameInstance_t;
+
 void userInput(UserAction_t action, bool hold);
 GameInfo_t updateCurrentState(void);
 int isGameOver(void);
 void freeGameInfo(GameInfo_t *g);
+void getFieldSize(int *rows, int *cols);
+void getMotionHint(MotionHint_t *hint);
+int setFieldSize(int rows, int cols);
+const unsigned *getFieldRowVersions(void);
+void getFocusCell(int *row, int *col);
+void setRandomSeed(unsigned seed);
+void resetGame(void);
+void setHighScorePersistence(int on);
+const char *gameName(void);
+void getFsmStats(FsmStats_t *out);
+void resetFsmStats(void);
+int dumpFsmStats(const char *path);
+
+GameInstance_t *gameCreate(void);
+void gameSelect(GameInstance_t *game);
+void gameDestroy(GameInstance_t *game);
 
 #ifdef __cplusplus
 }
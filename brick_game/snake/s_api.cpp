@@ -1,7 +1,8 @@
-#include <cstdlib>
+#include <cstring>
 
 #include "brick_game_api.h"
 #include "snake.h"
+#include "trace.h"
 
 namespace snake {
 
@@ -9,72 +10,52 @@ void SnakeHandleInput(UserAction_t action, bool hold);
 
 namespace {
 
-void AllocateMatrix(int rows, int cols, int*** out_rows) {
-  int** rows_ptr = static_cast<int**>(std::malloc(sizeof(int*) * rows));
-  int r = 0;
-  while (r < rows) {
-    rows_ptr[r] = static_cast<int*>(std::malloc(sizeof(int) * cols));
-    int c = 0;
-    while (c < cols) {
-      rows_ptr[r][c] = 0;
-      c = c + 1;
-    }
-    r = r + 1;
-  }
-  *out_rows = rows_ptr;
-}
-
-void FreeMatrix(int rows, int*** rows_ptr) {
-  if (rows_ptr && *rows_ptr) {
-    int r = 0;
-    while (r < rows) {
-      if ((*rows_ptr)[r]) std::free((*rows_ptr)[r]);
-      r = r + 1;
-    }
-    std::free(*rows_ptr);
-    *rows_ptr = nullptr;
-  }
-}
-
-
 void EnsureInit() {
-  static int initialized = 0;
-  if (initialized == 0) {
-    GlobalSnake().Init(10, 20);
-    initialized = 1;
+  GameInstance& instance = CurrentInstance();
+  if (!instance.initialized) {
+    instance.game.Init(instance.cols, instance.rows);
+    instance.initialized = true;
   }
 }
 
 
-
-static int** BuildFieldMatrix(int h, int w) {
-  int** rows = nullptr;
-  AllocateMatrix(h, w, &rows);
-  return rows;
-}
-
-
-static void RenderBodyAndFood(int** field, int h, int w) {
-  const std::deque<Point>& body = GlobalSnake().Body();
-  int i = 0;
-  while (i < static_cast<int>(body.size())) {
-    int cx = body[i].x;
-    int cy = body[i].y;
-    if (cy >= 0 && cy < h && cx >= 0 && cx < w) {
-      field[cy][cx] = 1;
-    }
-    i = i + 1;
+void RebuildField(GameInstance& instance, int h, int w) {
+  instance.field_cells.assign(static_cast<size_t>(h) * w, 0);
+  instance.field_rows.resize(static_cast<size_t>(h));
+  instance.row_versions.resize(static_cast<size_t>(h));
+  int* cells = instance.field_cells.data();
+  for (int r = 0; r < h; ++r) {
+    instance.field_rows[r] = cells + static_cast<size_t>(r) * w;
+    instance.row_versions[r] += 1;
   }
-  Point food = GlobalSnake().Food();
+  int** field = instance.field_rows.data();
+  for (const Point& b : instance.game.Body()) {
+    if (b.y >= 0 && b.y < h && b.x >= 0 && b.x < w) field[b.y][b.x] = 1;
+  }
+  Point food = instance.game.Food();
   if (food.y >= 0 && food.y < h && food.x >= 0 && food.x < w) {
     field[food.y][food.x] = 2;
   }
 }
 
-static int** BuildEmptyNextPreview() {
-  int** next = nullptr;
-  AllocateMatrix(4, 4, &next);
-  return next;
+
+void SyncField(GameInstance& instance) {
+  SnakeGame& game = instance.game;
+  int h = game.Height();
+  int w = game.Width();
+  if (game.LayoutReset() ||
+      instance.field_cells.size() != static_cast<size_t>(h) * w) {
+    RebuildField(instance, h, w);
+  } else {
+    for (const CellChange& c : game.Changes()) {
+      instance.field_rows[c.y][c.x] = c.value;
+      instance.row_versions[c.y] += 1;
+    }
+  }
+  game.ClearChanges();
+  for (int r = 0; r < 4; ++r) {
+    instance.next_rows[r] = instance.next_cells + r * 4;
+  }
 }
 }
 
@@ -88,30 +69,115 @@ void userInput(UserAction_t action, bool hold) {
 }
 
 GameInfo_t updateCurrentState(void) {
+  trace_begin("updateCurrentState");
   snake::EnsureInit();
-  snake::GlobalSnake().Step();
-
-  int h = snake::GlobalSnake().Height();
-  int w = snake::GlobalSnake().Width();
-  int** field_rows = snake::BuildFieldMatrix(h, w);
-  snake::RenderBodyAndFood(field_rows, h, w);
-  int** next_rows = snake::BuildEmptyNextPreview();
+  GameInstance& instance = snake::CurrentInstance();
+  instance.game.Step();
+  snake::SyncField(instance);
 
   GameInfo_t g;
-  g.field = field_rows;
-  g.next = next_rows;
+  g.field = instance.field_rows.data();
+  g.next = instance.next_rows;
   g.score = snake::GlobalSnake().Score();
   g.high_score = snake::GlobalSnake().HighScore();
   g.level = snake::GlobalSnake().Level();
   g.speed = snake::GlobalSnake().SpeedMs();
   g.pause = snake::GlobalSnake().Paused() ? 1 : 0;
+  trace_end("updateCurrentState");
   return g;
 }
 
-void freeGameInfo(GameInfo_t* g) {
-  if (g != nullptr) {
-    snake::FreeMatrix(snake::GlobalSnake().Height(), &g->field);
-    snake::FreeMatrix(4, &g->next);
+void freeGameInfo(GameInfo_t* g) { (void)g; }
+
+void getFieldSize(int* rows, int* cols) {
+  snake::EnsureInit();
+  if (rows != nullptr) *rows = snake::GlobalSnake().Height();
+  if (cols != nullptr) *cols = snake::GlobalSnake().Width();
+}
+
+int setFieldSize(int rows, int cols) {
+  long long cells = static_cast<long long>(rows) * cols;
+  if (rows < 4 || cols < 8 || cells > (1LL << 26)) return 0;
+  GameInstance& instance = snake::CurrentInstance();
+  instance.rows = rows;
+  instance.cols = cols;
+  instance.initialized = false;
+  instance.terminate_latched = false;
+  snake::EnsureInit();
+  return 1;
+}
+
+void setRandomSeed(unsigned seed) {
+  (void)seed;
+  resetGame();
+}
+
+void resetGame(void) {
+  GameInstance& instance = snake::CurrentInstance();
+  instance.initialized = false;
+  instance.terminate_latched = false;
+}
+
+void setHighScorePersistence(int on) {
+  snake::GlobalSnake().SetHighScorePersistence(on != 0);
+}
+
+const char* gameName(void) { return "snake"; }
+
+void getFsmStats(FsmStats_t* out) {
+  static const char* const kStateNames[] = {"START", "INPUT",  "DROP",
+                                            "FIX",   "PAUSED", "GAMEOVER"};
+  fsm_stats_export(snake::GlobalSnake().FsmStats(), kStateNames,
+                   snake::STATE_GAMEOVER + 1, out);
+}
+
+void resetFsmStats(void) {
+  FsmCounters* c = snake::GlobalSnake().FsmStats();
+  if (c != nullptr) std::memset(c, 0, sizeof(*c));
+}
+
+int dumpFsmStats(const char* path) {
+  FsmStats_t s;
+  getFsmStats(&s);
+  return fsm_stats_write(&s, gameName(), path);
+}
+
+const unsigned* getFieldRowVersions(void) {
+  const GameInstance& instance = snake::CurrentInstance();
+  if (instance.row_versions.empty()) return nullptr;
+  return instance.row_versions.data();
+}
+
+void getFocusCell(int* row, int* col) {
+  snake::EnsureInit();
+  const snake::PointRing& body = snake::GlobalSnake().Body();
+  snake::Point head = body.empty() ? snake::Point{0, 0} : body.front();
+  if (row != nullptr) *row = head.y;
+  if (col != nullptr) *col = head.x;
+}
+
+void getMotionHint(MotionHint_t* hint) {
+  snake::EnsureInit();
+  if (hint == nullptr) return;
+  const snake::SnakeGame& game = snake::GlobalSnake();
+  hint->clock_ns = game.StepClockNs();
+  hint->interval_ms = game.StepIntervalMs();
+  hint->progress = game.StepProgress();
+  hint->count = 0;
+
+  snake::Point next{0, 0};
+  bool grows = false;
+  const snake::PointRing& body = game.Body();
+  if (body.size() < 2 || !game.NextMove(&next, &grows)) return;
+
+  const snake::Point head = body.front();
+  hint->cells[hint->count++] = {head.y, head.x, next.y - head.y,
+                                next.x - head.x, MotionGrow};
+  if (!grows) {
+    const snake::Point tail = body.back();
+    const snake::Point before = body[body.size() - 2];
+    hint->cells[hint->count++] = {tail.y, tail.x, before.y - tail.y,
+                                  before.x - tail.x, MotionShrink};
   }
 }
 
@@ -131,20 +197,33 @@ int isWin(void) {
 
 int t_take_terminate(void) {
   snake::EnsureInit();
-  static int latched = 0;
+  bool& latched = snake::CurrentInstance().terminate_latched;
   int result = 0;
 
   if (snake::GlobalSnake().GameOver() || snake::GlobalSnake().TakeTerminateOnce()) {
-    if (latched == 0) {
+    if (!latched) {
       result = 1;
-      latched = 1;
+      latched = true;
     } else {
       result = 0;
     }
   } else {
-    latched = 0;
+    latched = false;
   }
 
   return result;
 }
+
+
+GameInstance_t* gameCreate(void) { return new GameInstance(); }
+
+
+void gameSelect(GameInstance_t* game) { snake::SelectInstance(game); }
+
+
+void gameDestroy(GameInstance_t* game) {
+  if (game == nullptr) return;
+  if (&snake::CurrentInstance() == game) snake::SelectInstance(nullptr);
+  delete game;
+}
 }
@@ -4,10 +4,41 @@
 #include <fstream>
 #include <limits>
 
+#include "bg_clock.h"
 #include "snake.h"
+#include "trace.h"
 
 namespace snake {
 
+void PointRing::reserve(size_t n) {
+  if (n <= buf_.size()) return;
+  std::vector<Point> grown(n);
+  for (size_t i = 0; i < size_; ++i) grown[i] = (*this)[i];
+  buf_.swap(grown);
+  head_ = 0;
+}
+
+
+void PointRing::Grow() { reserve(buf_.empty() ? 16 : buf_.size() * 2); }
+
+
+void PointRing::push_front(const Point& p) {
+  if (size_ == buf_.size()) Grow();
+  head_ = head_ == 0 ? buf_.size() - 1 : head_ - 1;
+  buf_[head_] = p;
+  ++size_;
+}
+
+
+void PointRing::push_back(const Point& p) {
+  if (size_ == buf_.size()) Grow();
+  size_t at = head_ + size_;
+  if (at >= buf_.size()) at -= buf_.size();
+  buf_[at] = p;
+  ++size_;
+}
+
+
 void SnakeGame::Init(int w, int h) {
   InitHighScoreIfNeeded();
   InitGeometry(w, h);
@@ -33,7 +64,7 @@ void SnakeGame::InitGeometry(int w, int h) {
   if (tick_limit_base_ < 1) tick_limit_base_ = 1;
   tick_limit_fast_ = kDefaultTickFast;
   if (tick_limit_fast_ < 1) tick_limit_fast_ = 1;
-  tick_counter_ = 0;
+  ResetStepClock();
 }
 
 
@@ -47,12 +78,42 @@ int SnakeGame::SpeedMs() const {
 }
 
 
+double SnakeGame::StepIntervalMs() const {
+  return static_cast<double>((EffectiveTickLimit() + 2) * SpeedMs());
+}
+
+
+double SnakeGame::StepProgress() const {
+  double progress = step_acc_ms_ / StepIntervalMs();
+  if (progress < 0.0) progress = 0.0;
+  if (progress > 1.0) progress = 1.0;
+  return progress;
+}
+
+
+long long SnakeGame::StepClockNs() const { return last_tick_ns_; }
+
+
+bool SnakeGame::NextMove(Point* head, bool* grows) const {
+  Point next = NextHeadPoint();
+  bool eat = WillEatAt(next);
+  if (head != nullptr) *head = next;
+  if (grows != nullptr) *grows = eat;
+  return !game_over_ && !paused_ && !DetectCollisionAt(next, eat);
+}
+
+
+void SnakeGame::ResetStepClock() {
+  last_tick_ns_ = bg_clock_now_ns();
+  step_acc_ms_ = 0.0;
+}
+
+
 void SnakeGame::InitRuntimeState() {
   ResetRuntimeFlags();
   InitBodyStart();
   InitFoodFromSeed(body_.front());
-  tick_counter_ = 0;
-  last_move_tp_ = std::chrono::steady_clock::now();
+  ResetStepClock();
 }
 
 
@@ -68,35 +129,79 @@ void SnakeGame::ResetRuntimeFlags() {
 
 
 void SnakeGame::InitBodyStart() {
+  const size_t cells = static_cast<size_t>(width_) * height_;
   body_.clear();
+  body_.reserve(cells < kBodyReserve ? cells : kBodyReserve);
+  occupied_.assign(cells, 0);
+  changes_.clear();
+  layout_reset_ = true;
   Point head{width_ / 2, height_ / 2};
   body_.push_front(head);
   body_.push_back(Point{head.x - 1, head.y});
   body_.push_back(Point{head.x - 2, head.y});
   body_.push_back(Point{head.x - 3, head.y});
+  for (const auto& b : body_) SetOccupied(b, true);
 }
 
 
 void SnakeGame::InitFoodFromSeed(const Point& seed) {
   int nx = (std::abs(seed.x * 31 + seed.y * 17 + score_ * 13)) % width_;
   int ny = (std::abs(seed.x * 7 + seed.y * 11 + score_ * 5)) % height_;
-  bool found = false;
   int total = width_ * height_;
   for (int k = 0; k < total; ++k) {
     int x = (nx + k) % width_;
     int y = (ny + k / width_) % height_;
-    bool occ = false;
-    for (const auto& b : body_) {
-      if (b.x == x && b.y == y) {
-        occ = true;
-      }
-    }
-    if (!occ && !found) {
+    if (!Occupied(x, y)) {
       food_.x = x;
       food_.y = y;
-      found = true;
+      break;
     }
   }
+  RecordChange(food_, 2);
+}
+
+
+bool SnakeGame::Occupied(int x, int y) const {
+  return occupied_[static_cast<size_t>(y) * width_ + x] != 0;
+}
+
+
+void SnakeGame::SetOccupied(const Point& p, bool on) {
+  if (p.x < 0 || p.x >= width_ || p.y < 0 || p.y >= height_) return;
+  occupied_[static_cast<size_t>(p.y) * width_ + p.x] = on ? 1 : 0;
+  RecordChange(p, on ? 1 : 0);
+}
+
+
+void SnakeGame::RecordChange(const Point& p, int value) {
+  if (layout_reset_) return;
+  if (changes_.size() >= kMaxPendingChanges) {
+    changes_.clear();
+    layout_reset_ = true;
+    return;
+  }
+  changes_.push_back(CellChange{p.x, p.y, value});
+}
+
+
+const std::vector<CellChange>& SnakeGame::Changes() const { return changes_; }
+
+
+bool SnakeGame::LayoutReset() const { return layout_reset_; }
+
+
+void SnakeGame::ClearChanges() {
+  changes_.clear();
+  layout_reset_ = false;
+}
+
+
+FsmCounters* SnakeGame::FsmStats() {
+#ifdef BG_FSM_STATS
+  return &fsm_stats_;
+#else
+  return nullptr;
+#endif
 }
 
 
@@ -161,16 +266,9 @@ bool SnakeGame::DetectCollisionAt(const Point& p, bool will_eat) const {
   bool collides = false;
   if (p.x < 0 || p.x >= width_ || p.y < 0 || p.y >= height_) {
     collides = true;
-  } else {
-    size_t limit = body_.size();
-    if (!will_eat && limit > 0) limit -= 1;
-    bool hit_body = false;
-    for (size_t i = 0; i < limit; ++i) {
-      if (body_[i].x == p.x && body_[i].y == p.y) {
-        hit_body = 1;
-      }
-    }
-    collides = hit_body;
+  } else if (Occupied(p.x, p.y)) {
+    const Point& tail = body_.back();
+    collides = will_eat || tail.x != p.x || tail.y != p.y;
   }
   return collides;
 }
@@ -212,7 +310,6 @@ void SnakeGame::SpawnFoodNext() {
   int nx = (std::abs(s1) + std::abs(s2)) % width_;
   int ny = (std::abs(s1 * 7) + std::abs(s2 * 11)) % height_;
 
-  bool found = false;
   int total = width_ * height_;
 
   for (int k = 0; k < total; ++k) {
@@ -220,23 +317,22 @@ void SnakeGame::SpawnFoodNext() {
 
     int y = (ny + k / width_) % height_;
 
-    bool occ = false;
-    for (const auto& b : body_) {
-      if (b.x == x && b.y == y) {
-        occ = true;
-      }
-    }
-
-    if (!occ && !found) {
+    if (!Occupied(x, y)) {
       food_.x = x;
       food_.y = y;
-      found = true;
+      break;
     }
   }
+  RecordChange(food_, 2);
 }
 
 void SnakeGame::ApplyMoveOrEat(const Point& p, bool will_eat) {
+  if (!will_eat) {
+    SetOccupied(body_.back(), false);
+    body_.pop_back();
+  }
   body_.push_front(p);
+  SetOccupied(p, true);
   if (will_eat) {
     score_ += 1;
     if (high_score_ < score_) {
@@ -245,8 +341,6 @@ void SnakeGame::ApplyMoveOrEat(const Point& p, bool will_eat) {
     }
     MaybeLevelUp();
     SpawnFoodNext();
-  } else {
-    body_.pop_back();
   }
 }
 
@@ -260,6 +354,7 @@ bool SnakeGame::TakeTerminateOnce() {
 }
 
 void SnakeGame::LoadHighScoreFromFile() {
+  if (!persist_high_) return;
   int loaded = 0;
   std::ifstream fin(highscore_path_);
   if (fin.good()) {
@@ -279,8 +374,13 @@ void SnakeGame::LoadHighScoreFromFile() {
 }
 
 void SnakeGame::SaveHighScoreToFile() const {
-  std::ofstream fout(highscore_path_, std::ios::trunc);
-  if (fout.good()) fout << high_score_ << "\n";
+  if (!persist_high_) return;
+  trace_begin("SaveHighScoreToFile");
+  {
+    std::ofstream fout(highscore_path_, std::ios::trunc);
+    if (fout.good()) fout << high_score_ << "\n";
+  }
+  trace_end("SaveHighScoreToFile");
 }
 
 
@@ -291,21 +391,25 @@ void SnakeGame::FSM_StepInput() { ApplyPendingTurnOnce(); }
 
 
 bool SnakeGame::FSM_StepDrop() {
+  long long now = bg_clock_now_ns();
+  double elapsed = static_cast<double>(now - last_tick_ns_) / 1e6;
+  last_tick_ns_ = now;
+  if (elapsed < 0.0) elapsed = 0.0;
+
   bool ready = false;
   if (accelerate_step_) {
     accelerate_step_ = false;
-    tick_counter_ = 0;
-    last_move_tp_ = std::chrono::steady_clock::now();
+    step_acc_ms_ = 0.0;
     ready = true;
   } else {
-    int limit = EffectiveTickLimit();
-    if (tick_counter_ + 1 >= limit) {
-      tick_counter_ = 0;
-      last_move_tp_ = std::chrono::steady_clock::now();
+    double interval = StepIntervalMs();
+    step_acc_ms_ += elapsed;
+    if (step_acc_ms_ > interval * kMaxCatchUpSteps) {
+      step_acc_ms_ = interval * kMaxCatchUpSteps;
+    }
+    if (step_acc_ms_ >= interval) {
+      step_acc_ms_ -= interval;
       ready = true;
-    } else {
-      tick_counter_ += 1;
-      ready = false;
     }
   }
   return ready;
@@ -328,7 +432,7 @@ bool SnakeGame::FSM_StepFix() {
   return ok;
 }
 
-void SnakeGame::FSM_StepPaused() { tick_counter_ = 0; }
+void SnakeGame::FSM_StepPaused() { ResetStepClock(); }
 
 void SnakeGame::FSM_StepGameOver() {}
 
@@ -356,14 +460,17 @@ SnakeGame::SnakeGame()
       terminate_requested_(false),
       tick_limit_base_(kDefaultTickBase),
       tick_limit_fast_(kDefaultTickFast),
-      tick_counter_(0),
       level_(1),
       score_(0),
       high_score_(0),
       food_{0, 0},
       highscore_path_("snake_highscore.txt"),
       high_loaded_(false),
-      last_move_tp_(std::chrono::steady_clock::now()) {
+      persist_high_(true),
+      last_tick_ns_(bg_clock_now_ns()),
+      step_acc_ms_(0.0),
+      fsm_state_(STATE_START),
+      layout_reset_(true) {
   std::srand(static_cast<unsigned>(std::time(nullptr)));
 }
 
@@ -376,12 +483,14 @@ void SnakeGame::TogglePause() { paused_ = !paused_; }
 
 void SnakeGame::RequestTerminate() { terminate_requested_ = true; }
 
+void SnakeGame::SetHighScorePersistence(bool on) { persist_high_ = on; }
+
 
 int SnakeGame::Width() const { return width_; }
 
 int SnakeGame::Height() const { return height_; }
 
-const std::deque<Point>& SnakeGame::Body() const { return body_; }
+const PointRing& SnakeGame::Body() const { return body_; }
 
 Point SnakeGame::Food() const { return food_; }
 
@@ -404,9 +513,22 @@ bool SnakeGame::Paused() const { return paused_; }
 
 bool SnakeGame::GameOver() const { return game_over_; }
 
-SnakeGame& GlobalSnake() {
-  static SnakeGame instance;
-  return instance;
+namespace {
+GameInstance g_default_instance;
+thread_local GameInstance* t_current_instance = nullptr;
+}  // namespace
+
+
+GameInstance& CurrentInstance() {
+  return t_current_instance ? *t_current_instance : g_default_instance;
+}
+
+
+void SelectInstance(GameInstance* instance) {
+  t_current_instance = instance;
 }
 
+
+SnakeGame& GlobalSnake() { return CurrentInstance().game; }
+
 }  // namespace snake
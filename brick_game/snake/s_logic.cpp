@@ -1,27 +1,24 @@
 #include "snake.h"
+#include "trace.h"
 
 namespace snake {
 
-enum SnakeState {
-  STATE_START = 0,
-  STATE_INPUT,
-  STATE_DROP,
-  STATE_FIX,
-  STATE_PAUSED,
-  STATE_GAMEOVER
-};
-
-static SnakeState& SnakeStateRef() {
-  static SnakeState state = STATE_START;
-  return state;
-}
+static const char* const kStepNames[] = {
+    "FSM_StepStart", "FSM_StepInput",  "FSM_StepDrop",
+    "FSM_StepFix",   "FSM_StepPaused", "FSM_StepGameOver"};
 
 void SnakeGame::Step() {
-  SnakeState& st = SnakeStateRef();
+  SnakeState& st = fsm_state_;
   if (st == STATE_GAMEOVER && !game_over_) st = STATE_START;
-  if (st == STATE_PAUSED && !paused_) st = STATE_INPUT;
+  if (st == STATE_PAUSED && !paused_) {
+    ResetStepClock();
+    st = STATE_INPUT;
+  }
 
+  const SnakeState from = st;
+  FSM_STATS_BEGIN();
   SnakeState next = st;
+  trace_begin(kStepNames[from]);
   switch (st) {
     case STATE_START:
       FSM_StepStart();
@@ -38,7 +35,10 @@ void SnakeGame::Step() {
       }
       break;
     case STATE_DROP:
-      if (FSM_StepDrop()) {
+      if (paused_) {
+        FSM_StepPaused();
+        next = STATE_PAUSED;
+      } else if (FSM_StepDrop()) {
         next = STATE_FIX;
       } else {
         next = STATE_DROP;
@@ -60,7 +60,9 @@ void SnakeGame::Step() {
       next = STATE_GAMEOVER;
       break;
   }
+  trace_end(kStepNames[from]);
   st = next;
+  FSM_STATS_END(&fsm_stats_, from, next);
 }
 
 }  // namespace snake
@@ -1,9 +1,13 @@
 #ifndef SNAKE_H_
 #define SNAKE_H_
 
-#include <chrono>
-#include <deque>
+#include <cstddef>
 #include <string>
+#include <vector>
+
+#include "fsm_stats.h"
+
+struct SnakeBenchAccess;
 
 namespace snake {
 
@@ -13,8 +17,68 @@ struct Point {
 };
 
 enum class Direction { kUp, kDown, kLeft, kRight };
+
+enum SnakeState {
+  STATE_START = 0,
+  STATE_INPUT,
+  STATE_DROP,
+  STATE_FIX,
+  STATE_PAUSED,
+  STATE_GAMEOVER
+};
 enum class TurnRequest { kNone, kLeft, kRight };
 
+class PointRing {
+ public:
+  class const_iterator {
+   public:
+    const_iterator(const PointRing* ring, size_t i) : ring_(ring), i_(i) {}
+    const Point& operator*() const { return (*ring_)[i_]; }
+    const_iterator& operator++() {
+      ++i_;
+      return *this;
+    }
+    bool operator!=(const const_iterator& o) const { return i_ != o.i_; }
+
+   private:
+    const PointRing* ring_;
+    size_t i_;
+  };
+
+  void reserve(size_t n);
+  void clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const Point& operator[](size_t i) const {
+    size_t at = head_ + i;
+    if (at >= buf_.size()) at -= buf_.size();
+    return buf_[at];
+  }
+  const Point& front() const { return buf_[head_]; }
+  const Point& back() const { return (*this)[size_ - 1]; }
+  void push_front(const Point& p);
+  void push_back(const Point& p);
+  void pop_back() { --size_; }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size_); }
+
+ private:
+  void Grow();
+
+  std::vector<Point> buf_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+};
+
+struct CellChange {
+  int x;
+  int y;
+  int value;
+};
+
 class SnakeGame {
  public:
   SnakeGame();
@@ -29,10 +93,11 @@ class SnakeGame {
   void TogglePause();
   void RequestTerminate();
   bool TakeTerminateOnce();
+  void SetHighScorePersistence(bool on);
 
   int Width() const;
   int Height() const;
-  const std::deque<Point>& Body() const;
+  const PointRing& Body() const;
   Point Food() const;
   int Score() const;
   int HighScore() const;
@@ -43,6 +108,15 @@ class SnakeGame {
   bool GameOver() const;
 
   int SpeedMs() const;
+  double StepIntervalMs() const;
+  double StepProgress() const;
+  long long StepClockNs() const;
+  bool NextMove(Point* head, bool* grows) const;
+
+  const std::vector<CellChange>& Changes() const;
+  bool LayoutReset() const;
+  void ClearChanges();
+  FsmCounters* FsmStats();
 
   void FSM_StepStart();
   void FSM_StepInput();
@@ -53,6 +127,8 @@ class SnakeGame {
   void FSM_StepGameOver();
 
  private:
+  friend struct ::SnakeBenchAccess;
+
   void ApplyPendingTurnOnce();
   Point NextHeadPoint() const;
   bool WillEatAt(const Point& p) const;
@@ -71,11 +147,15 @@ class SnakeGame {
   void InitRuntimeState();
 
   bool IsOpposite(Direction a, Direction b) const;
+  void ResetStepClock();
+  bool Occupied(int x, int y) const;
+  void SetOccupied(const Point& p, bool on);
+  void RecordChange(const Point& p, int value);
 
  private:
   int width_;
   int height_;
-  std::deque<Point> body_;
+  PointRing body_;
   Direction current_direction_;
   TurnRequest pending_turn_;
   bool is_accelerating_;
@@ -85,23 +165,54 @@ class SnakeGame {
   bool terminate_requested_;
   int tick_limit_base_;
   int tick_limit_fast_;
-  int tick_counter_;
   int level_;
   int score_;
   int high_score_;
   Point food_;
   std::string highscore_path_;
   bool high_loaded_;
+  bool persist_high_;
+
+  long long last_tick_ns_;
+  double step_acc_ms_;
+  SnakeState fsm_state_;
 
-  std::chrono::steady_clock::time_point last_move_tp_;
+  std::vector<unsigned char> occupied_;
+  std::vector<CellChange> changes_;
+  bool layout_reset_;
+#ifdef BG_FSM_STATS
+  FsmCounters fsm_stats_ = {};
+#endif
 
   static constexpr int kDefaultTickBase = 5;
   static constexpr int kDefaultTickFast = 3;
+  static constexpr int kMaxCatchUpSteps = 2;
+  static constexpr size_t kMaxPendingChanges = 4096;
+  static constexpr size_t kBodyReserve = size_t{1} << 16;
 };
 
 SnakeGame& GlobalSnake();
 }  // namespace snake
 
+struct GameInstance {
+  snake::SnakeGame game;
+  bool initialized = false;
+  bool terminate_latched = false;
+  int rows = 20;
+  int cols = 10;
+
+  std::vector<int> field_cells;
+  std::vector<int*> field_rows;
+  std::vector<unsigned> row_versions;
+  int next_cells[16] = {};
+  int* next_rows[4] = {};
+};
+
+namespace snake {
+GameInstance& CurrentInstance();
+void SelectInstance(GameInstance* instance);
+}  // namespace snake
+
 #define g_snake snake::GlobalSnake()
 
 #endif
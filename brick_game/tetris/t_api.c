@@ -1,5 +1,12 @@
+#include <string.h>
+
 #include "brick_game_api.h"
 #include "tetris.h"
+#include "trace.h"
+
+static const char *const T_STATE_NAMES[] = {"START", "SPAWN",  "INPUT",
+                                            "DROP",  "FIX",    "PAUSED",
+                                            "GAMEOVER"};
 
 
 void userInput(UserAction_t action, bool hold) {
@@ -15,6 +22,7 @@ void userInput(UserAction_t action, bool hold) {
 
 
 GameInfo_t updateCurrentState(void) {
+  trace_begin("updateCurrentState");
   t_init();
 
   fsm_step();
@@ -30,6 +38,7 @@ GameInfo_t updateCurrentState(void) {
   g.level = t_get_level();
   g.speed = t_get_speed_ms();
   g.pause = t_is_paused();
+  trace_end("updateCurrentState");
   return g;
 }
 
@@ -44,3 +53,105 @@ int isGameOver(void) {
 }
 
 void freeGameInfo(GameInfo_t* g) { (void)g; }
+
+
+GameInstance_t *gameCreate(void) { return t_instance_new(); }
+
+
+void gameSelect(GameInstance_t *game) { t_instance_select(game); }
+
+
+void gameDestroy(GameInstance_t *game) {
+  if (game == NULL) return;
+  t_instance_free(game);
+}
+
+
+void getFieldSize(int *rows, int *cols) {
+  if (rows != 0) *rows = T_ROWS;
+  if (cols != 0) *cols = T_COLS;
+}
+
+
+int setFieldSize(int rows, int cols) {
+  return rows == T_ROWS && cols == T_COLS;
+}
+
+
+const unsigned *getFieldRowVersions(void) { return 0; }
+
+
+void setRandomSeed(unsigned seed) { t_set_seed(seed); }
+
+
+void resetGame(void) { t_reset_game(); }
+
+
+void setHighScorePersistence(int on) { t_set_persistence(on); }
+
+
+const char *gameName(void) { return "tetris"; }
+
+
+void getFsmStats(FsmStats_t *out) {
+  fsm_stats_export(t_fsm_counters(), T_STATE_NAMES, STATE_GAMEOVER + 1, out);
+}
+
+
+void resetFsmStats(void) {
+  FsmCounters *c = t_fsm_counters();
+  if (c != 0) memset(c, 0, sizeof(*c));
+}
+
+
+int dumpFsmStats(const char *path) {
+  FsmStats_t s;
+  getFsmStats(&s);
+  return fsm_stats_write(&s, gameName(), path);
+}
+
+
+void getFocusCell(int *row, int *col) {
+  t_init();
+  const Active *act = t_active();
+  int r = act->y + 1;
+  int c = act->x + 1;
+  if (r < 0) r = 0;
+  if (r >= T_ROWS) r = T_ROWS - 1;
+  if (c < 0) c = 0;
+  if (c >= T_COLS) c = T_COLS - 1;
+  if (row != 0) *row = r;
+  if (col != 0) *col = c;
+}
+
+
+void getMotionHint(MotionHint_t *hint) {
+  t_init();
+  if (hint == 0) return;
+  hint->clock_ns = t_tick_clock_ns();
+  hint->interval_ms = t_gravity_ms(t_is_fast_drop());
+  hint->progress = t_gravity_progress();
+  hint->count = 0;
+
+  TetrisState s = t_get_state();
+  if ((s != STATE_INPUT && s != STATE_DROP) || t_is_paused() != 0 ||
+      t_can_drop() == 0) {
+    return;
+  }
+  const Active *act = t_active();
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      int row = act->y + r;
+      if (act->shape.m[r][c] == 0 || row < 0 ||
+          hint->count >= MOTION_MAX_CELLS) {
+        continue;
+      }
+      MotionCell_t *cell = &hint->cells[hint->count++];
+      cell->row = row;
+      cell->col = act->x + c;
+      cell->dr = 1;
+      cell->dc = 0;
+      cell->kind = MotionSlide;
+    }
+  }
+}
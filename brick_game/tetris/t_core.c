@@ -4,7 +4,11 @@
 #include <string.h>
 #include <time.h>
 
+#include "bg_clock.h"
 #include "tetris.h"
+#include "trace.h"
+
+enum { T_MAX_CATCHUP_ROWS = 4 };
 
 typedef struct {
   int board[T_ROWS][T_COLS];
@@ -18,6 +22,7 @@ typedef struct {
   int next_id;
   int bag[7];
   int bag_index;
+  unsigned rng;
 
   int score;
   int high_score;
@@ -25,18 +30,37 @@ typedef struct {
   int lines_done;
 
   int tick_limit;
-  int tick;
+  long long tick_ns;
+  double gravity_acc_ms;
 
   TetrisState state;
   int paused;
 } TCore;
 
-static TCore *t_core_state(void) {
-  static TCore s;
-  return &s;
+struct GameInstance {
+  TCore core;
+  TInputState input;
+  int inited;
+  int seeded;
+  unsigned seed;
+  int no_persist;
+#ifdef BG_FSM_STATS
+  FsmCounters fsm;
+#endif
+};
+
+static GameInstance_t t_default_instance;
+static _Thread_local GameInstance_t *t_current_instance = NULL;
+
+static GameInstance_t *t_instance(void) {
+  return t_current_instance != NULL ? t_current_instance : &t_default_instance;
 }
+
+static TCore *t_core_state(void) { return &t_instance()->core; }
 #define S (*t_core_state())
 
+TInputState *t_input_state(void) { return &t_instance()->input; }
+
 static int tick_limit_for_level(int level) {
   if (level < 1) level = 1;
   double base = 10.0;
@@ -76,10 +100,25 @@ static void bind_rows(void) {
 }
 
 
+GameInstance_t *t_instance_new(void) {
+  return (GameInstance_t *)calloc(1, sizeof(GameInstance_t));
+}
+
+
+void t_instance_select(GameInstance_t *game) { t_current_instance = game; }
+
+
+void t_instance_free(GameInstance_t *game) {
+  if (game == NULL) return;
+  if (t_current_instance == game) t_current_instance = NULL;
+  free(game);
+}
+
+
 void t_init(void) {
-  static int inited = 0;
+  int *inited = &t_instance()->inited;
 
-  if (inited == 0) {
+  if (*inited == 0) {
     memset(&S, 0, sizeof(S));
     bind_rows();
 
@@ -87,28 +126,24 @@ void t_init(void) {
     S.lines_done = 0;
 
     S.tick_limit = 10;
-    S.tick = 0;
+    S.tick_ns = bg_clock_now_ns();
+    S.gravity_acc_ms = 0.0;
 
     S.state = STATE_START;
     S.paused = 0;
 
-    srand((unsigned)time(NULL));
+    GameInstance_t *inst = t_instance();
+    S.rng = inst->seeded != 0 ? inst->seed : (unsigned)time(NULL);
+    if (S.rng == 0) S.rng = 0x9E3779B9u;
     S.bag_index = 0;
     refill_bag();
     S.next_id = S.bag[S.bag_index++];
     S.high_score = 0;
-    inited = 1;
+    load_high_score();
+    *inited = 1;
     t_input_reset();
   }
 
-  int prev_high = S.high_score;
-
-  load_high_score();
-
-  if (S.high_score < prev_high) {
-    S.high_score = prev_high;
-  }
-
   if (S.score > S.high_score) {
     S.high_score = S.score;
     save_high_score();
@@ -169,23 +204,62 @@ void t_speed_dec(void) {
 }
 
 
-int t_tick_ready(void) {
+double t_gravity_ms(int fast) {
+  double ms = 2.0 * (double)t_get_speed_ms();
+  if (fast == 0) {
+    ms *= (double)(S.tick_limit + 1);
+  }
+  return ms;
+}
+
+
+int t_tick_ready(int fast) {
   int target = tick_limit_for_level(S.level);
   if (S.tick_limit != target) {
     S.tick_limit = target;
   }
 
-  int ready = 0;
-  S.tick += 1;
-  if (S.tick > S.tick_limit) {
-    S.tick = 0;
-    ready = 1;
+  long long now = bg_clock_now_ns();
+  double elapsed = (double)(now - S.tick_ns) / 1e6;
+  S.tick_ns = now;
+  if (elapsed < 0.0) elapsed = 0.0;
+
+  double period = t_gravity_ms(fast);
+  S.gravity_acc_ms += elapsed;
+  if (S.gravity_acc_ms > period * T_MAX_CATCHUP_ROWS) {
+    S.gravity_acc_ms = period * T_MAX_CATCHUP_ROWS;
   }
-  return ready;
+
+  int rows = (int)(S.gravity_acc_ms / period);
+  S.gravity_acc_ms -= (double)rows * period;
+  return rows;
 }
 
 
-void t_tick_reset(void) { S.tick = 0; }
+void t_tick_reset(void) {
+  S.tick_ns = bg_clock_now_ns();
+  S.gravity_acc_ms = 0.0;
+}
+
+
+double t_gravity_progress(void) {
+  double progress = S.gravity_acc_ms / t_gravity_ms(t_is_fast_drop());
+  if (progress < 0.0) progress = 0.0;
+  if (progress > 1.0) progress = 1.0;
+  return progress;
+}
+
+
+long long t_tick_clock_ns(void) { return S.tick_ns; }
+
+
+const Active *t_active(void) { return &S.act; }
+
+
+void t_set_active(const Active *a) { S.act = *a; }
+
+
+int *t_board_cells(void) { return &S.board[0][0]; }
 
 
 TetrisState t_get_state(void) { return S.state; }
@@ -452,11 +526,13 @@ static void apply_scoring_and_level(int cleared) {
 
 
 int t_clear_full_lines(void) {
+  trace_begin("t_clear_full_lines");
   int fullRow[T_ROWS];
   int cleared = mark_full_rows(fullRow);
   int writeRow = compress_board_down(fullRow);
   fill_top_zeros_from(writeRow);
   apply_scoring_and_level(cleared);
+  trace_end("t_clear_full_lines");
   return cleared;
 }
 
@@ -499,7 +575,39 @@ void t_build_next_preview(void) {
 
 static const char *HIGHSCORE_FILE = "tetris_highscore.txt";
 
+void t_set_seed(unsigned seed) {
+  GameInstance_t *inst = t_instance();
+  inst->seed = seed;
+  inst->seeded = 1;
+  inst->inited = 0;
+}
+
+
+void t_reset_game(void) { t_instance()->inited = 0; }
+
+
+void t_set_persistence(int on) { t_instance()->no_persist = on == 0; }
+
+
+FsmCounters *t_fsm_counters(void) {
+#ifdef BG_FSM_STATS
+  return &t_instance()->fsm;
+#else
+  return NULL;
+#endif
+}
+
+
+static unsigned next_random(void) {
+  S.rng ^= S.rng << 13;
+  S.rng ^= S.rng >> 17;
+  S.rng ^= S.rng << 5;
+  return S.rng;
+}
+
+
 static void load_high_score(void) {
+  if (t_instance()->no_persist != 0) return;
   FILE *f = fopen(HIGHSCORE_FILE, "r");
   int value = 0;
   int ok = 0;
@@ -521,11 +629,14 @@ static void load_high_score(void) {
 
 
 static void save_high_score(void) {
+  if (t_instance()->no_persist != 0) return;
+  trace_begin("save_high_score");
   FILE *f = fopen(HIGHSCORE_FILE, "w");
   if (f != NULL) {
     fprintf(f, "%d\n", S.high_score);
     fclose(f);
   }
+  trace_end("save_high_score");
 }
 
 
@@ -534,7 +645,7 @@ static void refill_bag(void) {
     S.bag[i] = i;
   }
   for (int i = 6; i > 0; --i) {
-    int j = rand() % (i + 1);
+    int j = (int)(next_random() % (unsigned)(i + 1));
     int tmp = S.bag[i];
     S.bag[i] = S.bag[j];
     S.bag[j] = tmp;
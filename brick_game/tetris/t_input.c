@@ -1,18 +1,6 @@
 #include "tetris.h"
 
 
-typedef struct {
-  int hasAction;
-  UserAction_t currentAction;
-  int isHoldDown;
-  int terminateRequested;
-} TInputState;
-
-
-static TInputState *t_input_state(void) {
-  static TInputState st = {0};
-  return &st;
-}
 #define IS (*t_input_state())
 
 
@@ -1,12 +1,18 @@
 #include "tetris.h"
+#include "trace.h"
 
 extern int t_is_fast_drop(void);
 extern int t_take_terminate(void);
 extern int t_take(UserAction_t *out);
 
+static const char *const T_LOGIC_NAMES[] = {
+    "logic_start", "logic_spawn",  "logic_input",   "logic_drop",
+    "logic_fix",   "logic_paused", "logic_gameover"};
+
 
 void fsm_step(void) {
   TetrisState s = t_get_state();
+  FSM_STATS_BEGIN();
   int terminated = 0;
   if (s != STATE_START) {
     if (t_take_terminate() != 0) {
@@ -17,6 +23,7 @@ void fsm_step(void) {
   if (terminated) {
     t_set_state(STATE_GAMEOVER);
   } else {
+    trace_begin(T_LOGIC_NAMES[s]);
     if (s == STATE_START) {
       logic_start();
     } else if (s == STATE_SPAWN) {
@@ -32,7 +39,9 @@ void fsm_step(void) {
     } else if (s == STATE_GAMEOVER) {
       logic_gameover();
     }
+    trace_end(T_LOGIC_NAMES[s]);
   }
+  FSM_STATS_END(t_fsm_counters(), s, t_get_state());
 }
 
 
@@ -90,20 +99,13 @@ void logic_input(void) {
 
 void logic_drop(void) {
   TetrisState next = STATE_INPUT;
-  if (t_is_fast_drop() != 0) {
-    if (t_can_drop() != 0) {
-      t_drop_one();
-      next = STATE_INPUT;
-    } else {
-      next = STATE_FIX;
-    }
-  } else if (t_tick_ready() != 0) {
-    if (t_can_drop() != 0) {
-      t_drop_one();
-      next = STATE_INPUT;
-    } else {
-      next = STATE_FIX;
-    }
+  int rows = t_tick_ready(t_is_fast_drop());
+  while (rows > 0 && t_can_drop() != 0) {
+    t_drop_one();
+    rows -= 1;
+  }
+  if (rows > 0) {
+    next = STATE_FIX;
   }
   t_set_state(next);
 }
@@ -127,6 +129,7 @@ void logic_paused(void) {
       next = STATE_GAMEOVER;
     } else if (a == Pause) {
       t_set_paused(0);
+      t_tick_reset();
       next = STATE_INPUT;
     }
   }
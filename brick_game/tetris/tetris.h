@@ -2,6 +2,7 @@
 #define TETRIS_H_
 
 #include "brick_game_api.h"
+#include "fsm_stats.h"
 
 typedef enum {
   STATE_START = 0,
@@ -25,6 +26,18 @@ typedef struct {
   int y;
 } Active;
 
+typedef struct {
+  int hasAction;
+  UserAction_t currentAction;
+  int isHoldDown;
+  int terminateRequested;
+} TInputState;
+
+TInputState *t_input_state(void);
+GameInstance_t *t_instance_new(void);
+void t_instance_select(GameInstance_t *game);
+void t_instance_free(GameInstance_t *game);
+
 void t_init(void);
 TetrisState t_get_state(void);
 void t_set_state(TetrisState s);
@@ -43,8 +56,14 @@ int t_get_tick_limit(void);
 void t_speed_inc(void);
 void t_speed_dec(void);
 
-int t_tick_ready(void);
+double t_gravity_ms(int fast);
+int t_tick_ready(int fast);
 void t_tick_reset(void);
+double t_gravity_progress(void);
+long long t_tick_clock_ns(void);
+const Active *t_active(void);
+void t_set_active(const Active *a);
+int *t_board_cells(void);
 
 int t_get_high_score(void);
 void t_reset_for_new_game(void);
@@ -65,6 +84,10 @@ void logic_paused(void);
 void logic_gameover(void);
 
 void t_reload_high_score(void);
+void t_set_seed(unsigned seed);
+void t_reset_game(void);
+void t_set_persistence(int on);
+FsmCounters *t_fsm_counters(void);
 
 void t_clear_field(void);
 void t_copy_board_to_field(void);
@@ -0,0 +1,225 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "dashboard.h"
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "autoplay.h"
+#include "bg_clock.h"
+#include "brick_game_api.h"
+#include "draw.h"
+
+typedef struct {
+  AutoPlayer player;
+  int *shadow;
+  int hud[2];
+  int visible;
+  int top;
+  int left;
+} DashTile;
+
+typedef struct {
+  DashTile *tiles;
+  int count;
+  int rows;
+  int cols;
+  int shown;
+  int paused;
+  int status[3];
+  unsigned long long restarts;
+  long long step_ns;
+} Dashboard;
+
+
+static void dash_setup_game(const Dashboard *d) {
+  int rows = 0, cols = 0;
+  getFieldSize(&rows, &cols);
+  if (rows != d->rows || cols != d->cols) setFieldSize(d->rows, d->cols);
+  if (d->paused != 0) userInput(Pause, false);
+}
+
+
+static int dash_open(Dashboard *d, int count) {
+  memset(d, 0, sizeof(*d));
+  getFieldSize(&d->rows, &d->cols);
+  d->tiles = (DashTile *)calloc((size_t)count, sizeof(DashTile));
+  if (d->tiles == 0) return 0;
+  for (int i = 0; i < count; ++i) {
+    DashTile *t = &d->tiles[i];
+    t->shadow = (int *)malloc(sizeof(int) * (size_t)d->rows * (size_t)d->cols);
+    if (t->shadow == 0) return 0;
+    int created = autoplay_open(&t->player, i);
+    d->count = i + 1;
+    if (created == 0) return 0;
+    dash_setup_game(d);
+  }
+  gameSelect(0);
+  return 1;
+}
+
+
+static void dash_close(Dashboard *d) {
+  gameSelect(0);
+  for (int i = 0; d->tiles != 0 && i < d->count; ++i) {
+    autoplay_close(&d->tiles[i].player);
+    free(d->tiles[i].shadow);
+  }
+  free(d->tiles);
+  memset(d, 0, sizeof(*d));
+}
+
+
+static void dash_layout(Dashboard *d) {
+  const TermBackend *term = interface_backend();
+  int scr_rows = 0, scr_cols = 0;
+  term->size(&scr_rows, &scr_cols);
+  int tile_w = d->cols + 2;
+  int tile_h = d->rows + 3;
+  int per_line = (scr_cols - 1) / (tile_w + 1);
+  int lines = (scr_rows - 1) / tile_h;
+  if (per_line < 1) per_line = 1;
+  if (lines < 1) lines = 1;
+
+  term->clear();
+  d->shown = 0;
+  for (int i = 0; i < 3; ++i) d->status[i] = -1;
+  for (int i = 0; i < d->count; ++i) {
+    DashTile *t = &d->tiles[i];
+    t->visible = i < per_line * lines;
+    t->top = 1 + (i / per_line) * tile_h;
+    t->left = 1 + (i % per_line) * (tile_w + 1);
+    t->hud[0] = -1;
+    t->hud[1] = -1;
+    for (int k = 0; k < d->rows * d->cols; ++k) t->shadow[k] = -1;
+    if (t->visible == 0) continue;
+    draw_border_classic(t->top, t->left, d->rows, d->cols, 1, 1);
+    d->shown = d->shown + 1;
+  }
+}
+
+
+static int dash_tile_changed(const Dashboard *d, const DashTile *t,
+                             const GameInfo_t *g) {
+  int changed = t->hud[0] != g->score || t->hud[1] != g->level;
+  for (int r = 0; changed == 0 && g->field != 0 && r < d->rows; ++r) {
+    changed = memcmp(t->shadow + (size_t)r * (size_t)d->cols, g->field[r],
+                     sizeof(int) * (size_t)d->cols) != 0;
+  }
+  return changed;
+}
+
+
+static void dash_draw_tile(const Dashboard *d, DashTile *t,
+                           const GameInfo_t *g) {
+  draw_matrix_cached(t->top, t->left, g->field, d->rows, d->cols, 1, 1,
+                     t->shadow);
+  if (t->hud[0] == g->score && t->hud[1] == g->level) return;
+  char line[32];
+  int width = d->cols + 2;
+  if (width > (int)sizeof(line) - 1) width = (int)sizeof(line) - 1;
+  snprintf(line, sizeof(line), "%-*.*s", width, width, "");
+  interface_backend()->put_text(t->top + d->rows + 2, t->left, line);
+  snprintf(line, (size_t)width + 1, "%d L%d", g->score, g->level);
+  interface_backend()->put_text(t->top + d->rows + 2, t->left, line);
+  t->hud[0] = g->score;
+  t->hud[1] = g->level;
+}
+
+
+static void dash_step(Dashboard *d) {
+  long long t0 = bg_clock_now_ns();
+  for (int i = 0; i < d->count; ++i) {
+    DashTile *t = &d->tiles[i];
+    gameSelect(t->player.game);
+    if (d->paused == 0) autoplay_drive(&t->player);
+    GameInfo_t g = updateCurrentState();
+    if (t->visible != 0 && dash_tile_changed(d, t, &g) != 0) {
+      dash_draw_tile(d, t, &g);
+    }
+    freeGameInfo(&g);
+    if (autoplay_restart_if_over(&t->player) != 0) {
+      dash_setup_game(d);
+      d->restarts = d->restarts + 1;
+    }
+  }
+  gameSelect(0);
+  d->step_ns = bg_clock_now_ns() - t0;
+}
+
+
+static void dash_draw_status(Dashboard *d) {
+  int values[3];
+  values[0] = d->shown;
+  values[1] = (int)d->restarts;
+  values[2] = (int)(d->step_ns / 100000LL);
+  if (memcmp(values, d->status, sizeof(values)) == 0) return;
+  memcpy(d->status, values, sizeof(values));
+  char line[96];
+  snprintf(line, sizeof(line),
+           "Fleet: %d games, %d shown, %d restarts, step %d.%d ms%s",
+           d->count, values[0], values[1], values[2] / 10, values[2] % 10,
+           d->paused != 0 ? "  [paused]" : "");
+  const TermBackend *term = interface_backend();
+  term->put_text(0, 1, line);
+  term->clear_eol(0, 1 + (int)strlen(line));
+}
+
+
+static void dash_toggle_pause(Dashboard *d) {
+  d->paused = !d->paused;
+  for (int i = 0; i < d->count; ++i) {
+    gameSelect(d->tiles[i].player.game);
+    userInput(Pause, false);
+  }
+  gameSelect(0);
+  for (int i = 0; i < 3; ++i) d->status[i] = -1;
+}
+
+
+void dashboard_run(int count, int fps) {
+  const TermBackend *term = interface_backend();
+  if (count < 1) count = 1;
+  if (fps < 1) fps = 1;
+  Dashboard d;
+  if (dash_open(&d, count) == 0 || term->open() == 0) {
+    dash_close(&d);
+    return;
+  }
+  dash_layout(&d);
+
+  long long period_ns = 1000000000LL / fps;
+  long long next_ns = bg_clock_now_ns();
+  int running = 1;
+  while (running != 0) {
+    long long left = next_ns - bg_clock_now_ns();
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    poll(&pfd, 1, left <= 0 ? 0 : (int)((left + 999999LL) / 1000000LL));
+
+    int ch = term->read_key();
+    while (ch != TERM_KEY_NONE) {
+      if (ch == 'q' || ch == 'Q' || ch == TERM_KEY_ESC) {
+        running = 0;
+      } else if (ch == 'p' || ch == 'P') {
+        dash_toggle_pause(&d);
+      } else if (ch == TERM_KEY_RESIZE) {
+        dash_layout(&d);
+      }
+      ch = term->read_key();
+    }
+
+    long long now = bg_clock_now_ns();
+    if (running != 0 && now >= next_ns) {
+      dash_step(&d);
+      dash_draw_status(&d);
+      interface_present();
+      next_ns += period_ns;
+      if (next_ns < now) next_ns = now + period_ns;
+    }
+  }
+  term->close();
+  dash_close(&d);
+}
@@ -0,0 +1,14 @@
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void dashboard_run(int count, int fps);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,89 +1,560 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "draw.h"
 
-#include <ncurses.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "alloc_track.h"
+#include "bg_clock.h"
 #include "brick_game_api.h"
+#include "latency.h"
+#include "perf_meter.h"
+#include "record.h"
+#include "sim.h"
+#include "term.h"
+#include "trace.h"
+
+enum {
+  KEY_BATCH = 64,
+  ACTION_RELEASE_MS = 120,
+  HUD_WIDTH = 24,
+  MIN_VIEW = 4,
+  MAP_MAX_W = 24,
+  PERF_LINES = 7
+};
+
+typedef struct {
+  int row;
+  int col;
+  int rows;
+  int cols;
+} Viewport;
+
+typedef struct {
+  int valid;
+  int rows;
+  int cols;
+  Viewport view;
+  int *board;
+  int next[16];
+  int has_next;
+  int hud[4];
+  char perf[PERF_LINES][HUD_WIDTH];
+  int banner;
+} DrawCache;
+
+typedef struct {
+  int active;
+  int rows;
+  int cols;
+  int scale;
+  int dots_w;
+  int dots_h;
+  int chars_w;
+  int chars_h;
+  int words;
+  uint64_t *bits;
+  uint64_t *scratch;
+  unsigned *seen;
+  unsigned *count;
+  unsigned char *dirty;
+  unsigned short *shown;
+} MiniMap;
+
+typedef struct {
+  unsigned long long total;
+  unsigned long long last_frame;
+} TermBytes;
+
+static const unsigned char BRAILLE_DX[8] = {0, 0, 0, 1, 1, 1, 0, 1};
+static const unsigned char BRAILLE_DY[8] = {0, 1, 2, 0, 1, 2, 3, 3};
+
+static unsigned long long last_drawn_seq = 0;
+static DrawCache draw_cache;
+static MiniMap minimap;
+static TermBytes term_bytes;
+static const TermBackend *term = 0;
+static int virtual_time = 0;
+static LatencyHist input_latency;
+static PerfMeter perf;
+static int perf_visible = 0;
+static int perf_toggle_key = 0;
+static unsigned latency_seen_id = 0;
+
+
+unsigned long long draw_frame_bytes(void) { return term_bytes.last_frame; }
+
+unsigned long long draw_total_bytes(void) { return term_bytes.total; }
+
+
+const LatencyHist *interface_input_latency(void) { return &input_latency; }
+
+
+void interface_toggle_overlay(void) {
+  perf_visible = !perf_visible;
+  if (term->count_output != 0) term->count_output(perf_visible);
+  if (perf_visible != 0) {
+    perf_meter_start(&perf);
+  } else {
+    perf_meter_stop(&perf);
+  }
+  interface_invalidate();
+  last_drawn_seq = 0;
+}
+
+
+void interface_use_backend(const TermBackend *backend) { term = backend; }
+
+
+const TermBackend *interface_backend(void) {
+  if (term == 0) term = term_ncurses_backend();
+  return term;
+}
+
+
+static void present_frame(void) {
+  trace_begin("present_frame");
+  term_bytes.last_frame = term->present();
+  term_bytes.total += term_bytes.last_frame;
+  trace_end("present_frame");
+}
+
+
+void interface_present(void) { present_frame(); }
+
+
+void interface_use_virtual_time(int on) {
+  virtual_time = on != 0;
+  bg_clock_set_manual(virtual_time);
+}
+
+
+static void minimap_release(void) {
+  free(minimap.bits);
+  free(minimap.scratch);
+  free(minimap.seen);
+  free(minimap.count);
+  free(minimap.dirty);
+  free(minimap.shown);
+  memset(&minimap, 0, sizeof(minimap));
+}
+
+
+static int minimap_prepare(int rows, int cols, int max_h, int max_w) {
+  if (max_h < 2 || max_w < 4) {
+    minimap_release();
+    return 0;
+  }
+  int scale = 1;
+  while ((cols + scale - 1) / scale > max_w * 2 ||
+         (rows + scale - 1) / scale > max_h * 4) {
+    scale = scale + 1;
+  }
+  int dots_w = (cols + scale - 1) / scale;
+  int dots_h = (rows + scale - 1) / scale;
+  int chars_w = (dots_w + 1) / 2;
+  int chars_h = (dots_h + 3) / 4;
+  if (minimap.active == 0 || minimap.rows != rows || minimap.cols != cols ||
+      minimap.scale != scale) {
+    minimap_release();
+    minimap.words = (cols + 63) / 64;
+    minimap.bits = (uint64_t *)calloc((size_t)rows * (size_t)minimap.words,
+                                      sizeof(uint64_t));
+    minimap.scratch = (uint64_t *)calloc((size_t)minimap.words,
+                                         sizeof(uint64_t));
+    minimap.seen = (unsigned *)calloc((size_t)rows, sizeof(unsigned));
+    minimap.count = (unsigned *)calloc((size_t)dots_w * (size_t)dots_h,
+                                       sizeof(unsigned));
+    minimap.dirty = (unsigned char *)malloc((size_t)chars_w * chars_h);
+    minimap.shown = (unsigned short *)malloc(sizeof(unsigned short) *
+                                             (size_t)chars_w * chars_h);
+    if (minimap.bits == 0 || minimap.scratch == 0 || minimap.seen == 0 ||
+        minimap.count == 0 || minimap.dirty == 0 || minimap.shown == 0) {
+      minimap_release();
+      return 0;
+    }
+    minimap.rows = rows;
+    minimap.cols = cols;
+    minimap.scale = scale;
+    minimap.dots_w = dots_w;
+    minimap.dots_h = dots_h;
+    minimap.chars_w = chars_w;
+    minimap.chars_h = chars_h;
+    minimap.active = 1;
+  }
+  for (int i = 0; i < chars_w * chars_h; ++i) {
+    minimap.dirty[i] = 1;
+    minimap.shown[i] = 0xFFFF;
+  }
+  return 1;
+}
+
+
+static void minimap_update(int **field, const unsigned *versions) {
+  int words = minimap.words;
+  for (int r = 0; r < minimap.rows; ++r) {
+    if (versions != 0) {
+      if (minimap.seen[r] == versions[r]) continue;
+      minimap.seen[r] = versions[r];
+    }
+    uint64_t *fresh = minimap.scratch;
+    memset(fresh, 0, sizeof(uint64_t) * (size_t)words);
+    const int *row = field[r];
+    for (int c = 0; c < minimap.cols; ++c) {
+      if (row[c] != 0) fresh[c >> 6] |= (uint64_t)1 << (c & 63);
+    }
+    uint64_t *old = minimap.bits + (size_t)r * (size_t)words;
+    int dy = r / minimap.scale;
+    unsigned *counts = minimap.count + (size_t)dy * (size_t)minimap.dots_w;
+    for (int w = 0; w < words; ++w) {
+      uint64_t diff = old[w] ^ fresh[w];
+      while (diff != 0) {
+        int b = __builtin_ctzll(diff);
+        int dx = (w * 64 + b) / minimap.scale;
+        if ((fresh[w] >> b) & 1u)
+          counts[dx] += 1;
+        else
+          counts[dx] -= 1;
+        minimap.dirty[(dy / 4) * minimap.chars_w + dx / 2] = 1;
+        diff &= diff - 1;
+      }
+      old[w] = fresh[w];
+    }
+  }
+}
+
+
+static void minimap_draw(int top, int left) {
+  for (int cy = 0; cy < minimap.chars_h; ++cy) {
+    for (int cx = 0; cx < minimap.chars_w; ++cx) {
+      int i = cy * minimap.chars_w + cx;
+      if (minimap.dirty[i] == 0) continue;
+      minimap.dirty[i] = 0;
+      unsigned dots = 0;
+      for (int k = 0; k < 8; ++k) {
+        int dx = cx * 2 + BRAILLE_DX[k];
+        int dy = cy * 4 + BRAILLE_DY[k];
+        if (dx < minimap.dots_w && dy < minimap.dots_h &&
+            minimap.count[dy * minimap.dots_w + dx] != 0) {
+          dots |= 1u << k;
+        }
+      }
+      if (minimap.shown[i] == dots) continue;
+      minimap.shown[i] = (unsigned short)dots;
+      term->put_braille(top + cy, left + cx, dots);
+    }
+  }
+}
 
 
 void interface_run(void) {
-  initscr();
-  cbreak();
-  noecho();
-  keypad(stdscr, TRUE);
-  nodelay(stdscr, TRUE);
-  curs_set(0);
+  if (interface_backend()->open() == 0) return;
   console_loop();
-  endwin();
+  term->close();
+  free(draw_cache.board);
+  draw_cache.board = 0;
+  draw_cache.valid = 0;
+  minimap_release();
+}
+
+
+/* Terminals send no key-up, only auto-repeat, so a held Space is released
+ * ACTION_RELEASE_MS after its last repeat or as soon as another key arrives. */
+static int action_release_timeout_ms(int action_down, long long last_ns) {
+  int timeout = -1;
+  if (action_down != 0) {
+    long long left =
+        last_ns + ACTION_RELEASE_MS * 1000000LL - bg_clock_now_ns();
+    timeout = left <= 0 ? 0 : (int)((left + 999999LL) / 1000000LL);
+  }
+  return timeout;
 }
 
 
 void console_loop(void) {
+  KeyEvent events[KEY_BATCH];
   int running = 1;
   int quit_overlay = 0;
   int action_down = 0;
+  long long action_ns = 0;
+  if (sim_start() == 0) return;
+  perf_toggle_key = 1;
+
+  struct pollfd fds[2];
+  fds[0].fd = STDIN_FILENO;
+  fds[0].events = POLLIN;
+  fds[1].fd = sim_frame_fd();
+  fds[1].events = POLLIN;
+
   while (running != 0) {
-    int last = read_last_keypress();
-    process_last_key(last, &action_down, &quit_overlay);
-    if (action_down && last != ' ') {
-      userInput(Action, 0);
+    poll(fds, 2, action_release_timeout_ms(action_down, action_ns));
+    int n = read_key_events(events, KEY_BATCH);
+    while (n > 0) {
+      for (int i = 0; i < n; ++i) {
+        if (events[i].ch == TERM_KEY_RESIZE) {
+          interface_invalidate();
+          last_drawn_seq = 0;
+          continue;
+        }
+        if (events[i].ch == 'o' || events[i].ch == 'O') {
+          interface_toggle_overlay();
+          continue;
+        }
+        process_key_event(&events[i], &action_down, &quit_overlay);
+        if (events[i].ch == ' ') action_ns = events[i].t_ns;
+      }
+      n = read_key_events(events, KEY_BATCH);
+    }
+    if (action_down && action_release_timeout_ms(action_down, action_ns) == 0) {
+      sim_post_input(Action, 0);
       action_down = 0;
     }
     if (quit_overlay) {
       sleep_ms(250);
       break;
     }
-    running = step_and_draw_once();
+    running = present_latest_frame();
+    if (latency_take_request()) {
+      latency_print(&input_latency, "input-latency", stderr);
+    }
   }
+  sim_stop();
+}
+
+
+int present_latest_frame(void) {
+  int should_continue = 1;
+  const SimFrame *f = sim_latest();
+  if (f != 0) {
+    GameInfo_t g = sim_frame_info(f);
+    if (f->seq != last_drawn_seq) {
+      DrawHints hints = {f->focus_row, f->focus_col, f->row_version};
+      interface_draw_hinted(&g, f->rows, f->cols, f->game_over, &hints);
+      record_frame(f);
+      last_drawn_seq = f->seq;
+      if (f->input_id != latency_seen_id) {
+        latency_seen_id = f->input_id;
+        latency_record(&input_latency, bg_clock_now_ns() - f->input_ns);
+      }
+    }
+    if (f->game_over != 0 || f->terminated != 0) {
+      present_frame();
+      sleep_ms(BG_FRAME_GAME_OVER_MS);
+      should_continue = 0;
+    }
+  }
+  return should_continue;
 }
 
 
 int step_and_draw_once(void) {
   int should_continue = 1;
   GameInfo_t g = updateCurrentState();
-  interface_draw(&g);
-  if (isGameOver() != 0 || t_take_terminate() != 0) {
-    refresh();
-    sleep_ms(800);
+  int game_over = isGameOver();
+  int rows = 0, cols = 0;
+  getFieldSize(&rows, &cols);
+  DrawHints hints = {0, 0, getFieldRowVersions()};
+  getFocusCell(&hints.focus_row, &hints.focus_col);
+  interface_draw_hinted(&g, rows, cols, game_over, &hints);
+  int finished = game_over != 0 || t_take_terminate() != 0;
+  if (finished != 0) {
+    present_frame();
     should_continue = 0;
-  } else {
-    int delay = g.speed;
-    if (delay < 1) delay = 1;
-    if (g.pause == 0)
-      sleep_ms(delay);
-    else
-      sleep_ms(50);
   }
+  sleep_ms(bg_frame_delay_ms(finished, g.pause, g.speed));
   freeGameInfo(&g);
   return should_continue;
 }
 
 
-void interface_draw(const GameInfo_t *g) {
+void interface_invalidate(void) { draw_cache.valid = 0; }
+
+
+static void view_fit(int rows, int cols, int left, int *view_rows,
+                     int *view_cols) {
+  int scr_rows = 0, scr_cols = 0;
+  term->size(&scr_rows, &scr_cols);
+  int fit_rows = scr_rows - 3;
+  int fit_cols = (scr_cols - left - 4 - HUD_WIDTH) / 2;
+  if (fit_rows < MIN_VIEW) fit_rows = MIN_VIEW;
+  if (fit_cols < MIN_VIEW) fit_cols = MIN_VIEW;
+  *view_rows = rows < fit_rows ? rows : fit_rows;
+  *view_cols = cols < fit_cols ? cols : fit_cols;
+}
+
+
+static int view_axis(int cam, int focus, int view, int total) {
+  int margin = view / 4;
+  if (focus < cam + margin || focus >= cam + view - margin) {
+    cam = focus - view / 2;
+  }
+  if (cam > total - view) cam = total - view;
+  if (cam < 0) cam = 0;
+  return cam;
+}
+
+
+static int view_follow(const DrawHints *hints) {
+  Viewport *v = &draw_cache.view;
+  int row = v->row, col = v->col;
+  if (hints != 0) {
+    row = view_axis(v->row, hints->focus_row, v->rows, draw_cache.rows);
+    col = view_axis(v->col, hints->focus_col, v->cols, draw_cache.cols);
+  }
+  int moved = row != v->row || col != v->col;
+  v->row = row;
+  v->col = col;
+  return moved;
+}
+
+
+static void draw_cache_reset_board(void) {
+  size_t count = (size_t)draw_cache.view.rows * (size_t)draw_cache.view.cols;
+  for (size_t i = 0; draw_cache.board != 0 && i < count; ++i) {
+    draw_cache.board[i] = -1;
+  }
+}
+
+
+static int draw_cache_prepare(int rows, int cols, int left) {
+  int view_rows = 0, view_cols = 0;
+  view_fit(rows, cols, left, &view_rows, &view_cols);
+  if (draw_cache.valid != 0 && draw_cache.rows == rows &&
+      draw_cache.cols == cols && draw_cache.view.rows == view_rows &&
+      draw_cache.view.cols == view_cols) {
+    return 0;
+  }
+  size_t count = (size_t)view_rows * (size_t)view_cols;
+  if (draw_cache.view.rows != view_rows || draw_cache.view.cols != view_cols ||
+      draw_cache.board == 0) {
+    free(draw_cache.board);
+    draw_cache.board = (int *)malloc(sizeof(int) * (count > 0 ? count : 1));
+  }
+  if (draw_cache.rows != rows || draw_cache.cols != cols) {
+    draw_cache.view.row = 0;
+    draw_cache.view.col = 0;
+  }
+  draw_cache.view.rows = view_rows;
+  draw_cache.view.cols = view_cols;
+  draw_cache_reset_board();
+  for (int i = 0; i < 16; ++i) draw_cache.next[i] = -1;
+  for (int i = 0; i < 4; ++i) draw_cache.hud[i] = -1;
+  memset(draw_cache.perf, 0, sizeof(draw_cache.perf));
+  draw_cache.has_next = 0;
+  draw_cache.banner = 0;
+  draw_cache.rows = rows;
+  draw_cache.cols = cols;
+  draw_cache.valid = 1;
+  return 1;
+}
+
+
+void interface_draw(const GameInfo_t *g, int rows, int cols, int game_over) {
+  interface_draw_hinted(g, rows, cols, game_over, 0);
+}
+
+
+static void draw_perf_overlay(int top, int left, const PerfSnapshot *p) {
+  char lines[PERF_LINES][HUD_WIDTH];
+  snprintf(lines[0], HUD_WIDTH, "Perf:");
+  snprintf(lines[1], HUD_WIDTH, "  frame %.2f ms", p->frame_ms);
+  snprintf(lines[2], HUD_WIDTH, "  tick  %.1f/%.1f Hz", p->tick_hz,
+           p->target_hz);
+  snprintf(lines[3], HUD_WIDTH, "  steps %.0f/s", p->steps_per_s);
+  if (alloc_track_available() != 0) {
+    snprintf(lines[4], HUD_WIDTH, "  alloc %.1f/frame", p->allocs_per_frame);
+  } else {
+    snprintf(lines[4], HUD_WIDTH, "  alloc n/a");
+  }
+  snprintf(lines[5], HUD_WIDTH, "  bytes %.0f/frame", p->bytes_per_frame);
+  snprintf(lines[6], HUD_WIDTH, "  queue %d", p->input_depth);
+  for (int i = 0; i < PERF_LINES; ++i) {
+    if (strcmp(lines[i], draw_cache.perf[i]) == 0) continue;
+    term->put_text(top + i, left, lines[i]);
+    term->clear_eol(top + i, left + (int)strlen(lines[i]));
+    memcpy(draw_cache.perf[i], lines[i], HUD_WIDTH);
+  }
+}
+
+
+static void draw_frame(const GameInfo_t *g, int rows, int cols,
+                       int game_over, const DrawHints *hints) {
   int cellw = 2;
   int cellh = 1;
   int top = 1;
   int left = 2;
+  int map_top = top + 12;
+  const Viewport *v = &draw_cache.view;
+
+  int fresh = draw_cache_prepare(rows, cols, left);
+  if (view_follow(hints) != 0 && fresh == 0) draw_cache_reset_board();
+  int hud_left = left + v->cols * cellw + 4;
+  if (fresh != 0) {
+    term->clear();
+    draw_border_classic(top, left, v->rows, v->cols, cellw, cellh);
+    draw_hud_controls(top, hud_left);
+    int scr_rows = 0, scr_cols = 0;
+    term->size(&scr_rows, &scr_cols);
+    int map_w = scr_cols - hud_left - 1;
+    if (map_w > MAP_MAX_W) map_w = MAP_MAX_W;
+    if ((v->rows == rows && v->cols == cols) || perf_visible != 0) {
+      minimap_release();
+    } else if (minimap_prepare(rows, cols, scr_rows - map_top - 2, map_w)) {
+      term->put_text(map_top, hud_left, "Map:");
+    }
+  }
+  if (draw_cache.banner != 0 && game_over == 0) {
+    draw_cache.valid = 0;
+    draw_frame(g, rows, cols, game_over, hints);
+    return;
+  }
 
-  clear();
-
-  draw_border_classic(top, left, 20, 10, cellw, cellh);
-  draw_matrix_classic(top, left, g ? g->field : 0, 20, 10, cellw, cellh);
-
-  int hud_left = left + 10 * cellw + 4;
-  draw_hud_classic(top, hud_left, g);
+  draw_matrix_window(top, left, g ? g->field : 0, v->row, v->col, v->rows,
+                     v->cols, cellw, cellh, draw_cache.board);
+  draw_hud_values(top, hud_left, g, draw_cache.hud);
 
-  if (g && g->next != 0) {
-    mvprintw(top + 12, hud_left, "Next:");
-    draw_matrix_classic(top + 13, hud_left, g->next, 4, 4, cellw, cellh);
+  if (perf_visible != 0) {
+    draw_perf_overlay(top + 12, hud_left, &perf.shown);
+  } else if (minimap.active != 0) {
+    if (g && g->field != 0) {
+      minimap_update(g->field, hints != 0 ? hints->row_version : 0);
+    }
+    minimap_draw(map_top + 1, hud_left);
+  } else if (g && g->next != 0) {
+    if (draw_cache.has_next == 0) {
+      term->put_text(top + 12, hud_left, "Next:");
+      draw_cache.has_next = 1;
+    }
+    draw_matrix_cached(top + 13, hud_left, g->next, 4, 4, cellw, cellh,
+                       draw_cache.next);
   }
 
-  if (isGameOver() != 0) {
-    draw_game_over_banner_over_field(top, left, 20, 10, cellw, cellh);
+  if (game_over != 0 && draw_cache.banner == 0) {
+    draw_game_over_banner_over_field(top, left, v->rows, v->cols, cellw,
+                                     cellh);
+    draw_cache.banner = 1;
   }
 
-  refresh();
+  present_frame();
+}
+
+
+void interface_draw_hinted(const GameInfo_t *g, int rows, int cols,
+                           int game_over, const DrawHints *hints) {
+  trace_begin("interface_draw");
+  long long t0 = perf_visible != 0 ? bg_clock_real_ns() : 0;
+  draw_frame(g, rows, cols, game_over, hints);
+  if (perf_visible != 0) {
+    perf_meter_frame(&perf, bg_clock_real_ns() - t0, term_bytes.last_frame,
+                     g ? g->speed : 0);
+  }
+  trace_end("interface_draw");
 }
 
 
@@ -110,44 +581,70 @@ void draw_game_over_banner_over_field(int top, int left, int rows, int cols,
   int y = fy + (field_h - box_h) / 2;
 
   int scr_rows = 0, scr_cols = 0;
-  getmaxyx(stdscr, scr_rows, scr_cols);
+  term->size(&scr_rows, &scr_cols);
   if (x < 1) x = 1;
   if (y < 1) y = 1;
   if (x + box_w >= scr_cols) x = scr_cols - box_w - 1;
   if (y + box_h >= scr_rows) y = scr_rows - box_h - 1;
 
-  attron(A_BOLD);
-  mvprintw(y + 0, x + 0, "+");
-  for (int i = 0; i < box_w - 2; i++) mvprintw(y + 0, x + 1 + i, "-");
-  mvprintw(y + 0, x + box_w - 1, "+");
+  char line[64];
+  term->set_bold(1);
+  term->put_text(y + 0, x + 0, "+");
+  for (int i = 0; i < box_w - 2; i++) term->put_text(y + 0, x + 1 + i, "-");
+  term->put_text(y + 0, x + box_w - 1, "+");
+
+  snprintf(line, sizeof(line), "%-*s", box_w - 2, title);
+  term->put_text(y + 1, x + 1, line);
+  snprintf(line, sizeof(line), "%-*s", box_w - 2, hint);
+  term->put_text(y + 2, x + 1, line);
+
+  term->put_text(y + 3, x + 0, "+");
+  for (int i = 0; i < box_w - 2; i++) term->put_text(y + 3, x + 1 + i, "-");
+  term->put_text(y + 3, x + box_w - 1, "+");
+  term->set_bold(0);
+}
 
-  mvprintw(y + 1, x + 1, "%-*s", box_w - 2, title);
-  mvprintw(y + 2, x + 1, "%-*s", box_w - 2, hint);
 
-  mvprintw(y + 3, x + 0, "+");
-  for (int i = 0; i < box_w - 2; i++) mvprintw(y + 3, x + 1 + i, "-");
-  mvprintw(y + 3, x + box_w - 1, "+");
-  attroff(A_BOLD);
+void draw_hud_classic(int top, int left, const GameInfo_t *g) {
+  draw_hud_values(top, left, g, 0);
+  draw_hud_controls(top, left);
 }
 
 
-void draw_hud_classic(int top, int left, const GameInfo_t *g) {
-  int score = g ? g->score : 0;
-  int record = g ? g->high_score : 0;
-  int level = g ? g->level : 0;
-  int speed_ms = g ? g->speed : 0;
+void draw_hud_values(int top, int left, const GameInfo_t *g, int *shadow) {
+  int values[4];
+  values[0] = g ? g->score : 0;
+  values[1] = g ? g->high_score : 0;
+  values[2] = g ? g->level : 0;
+  values[3] = g ? g->speed : 0;
+  int speed_ms = values[3];
   double factor = (speed_ms > 0) ? (32.0 / (double)speed_ms) : 0.0;
 
-  mvprintw(top + 0, left, "Score : %d", score);
-  mvprintw(top + 1, left, "Record: %d", record);
-  mvprintw(top + 2, left, "Level : %d", level);
-  mvprintw(top + 3, left, "Speed : %d ms (x%.1f)", speed_ms, factor);
+  char line[64];
+  for (int i = 0; i < 4; ++i) {
+    if (shadow != 0 && shadow[i] == values[i]) continue;
+    if (i == 0) snprintf(line, sizeof(line), "Score : %d", values[0]);
+    if (i == 1) snprintf(line, sizeof(line), "Record: %d", values[1]);
+    if (i == 2) snprintf(line, sizeof(line), "Level : %d", values[2]);
+    if (i == 3) {
+      snprintf(line, sizeof(line), "Speed : %d ms (x%.1f)", speed_ms, factor);
+    }
+    term->put_text(top + i, left, line);
+    if (shadow != 0) {
+      term->clear_eol(top + i, left + (int)strlen(line));
+      shadow[i] = values[i];
+    }
+  }
+}
+
 
-  mvprintw(top + 5, left, "Controls:");
-  mvprintw(top + 6, left, "  Arrows  - move/rot.");
-  mvprintw(top + 7, left, "  Space   - action");
-  mvprintw(top + 8, left, "  P       - pause");
-  mvprintw(top + 9, left, "  Q/Esc   - quit");
+void draw_hud_controls(int top, int left) {
+  term->put_text(top + 5, left, "Controls:");
+  term->put_text(top + 6, left, "  Arrows  - move/rot.");
+  term->put_text(top + 7, left, "  Space   - action");
+  term->put_text(top + 8, left, "  P       - pause");
+  term->put_text(top + 9, left, "  Q/Esc   - quit");
+  if (perf_toggle_key != 0) term->put_text(top + 10, left, "  O       - perf");
 }
 
 extern int isGameOver(void);
@@ -159,10 +656,16 @@ void draw_game_over_banner_over_field(int top, int left, int rows, int cols,
 
 void sleep_ms(int ms) {
   if (ms <= 0) return;
+  if (virtual_time != 0) {
+    bg_clock_advance_ns((long long)ms * 1000000LL);
+    return;
+  }
   struct timespec ts;
   ts.tv_sec = ms / 1000;
   ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+  trace_begin("sleep_ms");
   nanosleep(&ts, 0);
+  trace_end("sleep_ms");
 }
 
 
@@ -171,22 +674,22 @@ void draw_border_classic(int top, int left, int rows, int cols, int cellw,
   int width = cols * cellw + 2;
   int height = rows * cellh + 2;
 
-  mvaddch(top, left, ACS_ULCORNER);
-  mvaddch(top, left + width - 1, ACS_URCORNER);
-  mvaddch(top + height - 1, left, ACS_LLCORNER);
-  mvaddch(top + height - 1, left + width - 1, ACS_LRCORNER);
+  term->put_glyph(top, left, TERM_GLYPH_ULCORNER);
+  term->put_glyph(top, left + width - 1, TERM_GLYPH_URCORNER);
+  term->put_glyph(top + height - 1, left, TERM_GLYPH_LLCORNER);
+  term->put_glyph(top + height - 1, left + width - 1, TERM_GLYPH_LRCORNER);
 
   int x = left + 1;
   while (x < left + width - 1) {
-    mvaddch(top, x, ACS_HLINE);
-    mvaddch(top + height - 1, x, ACS_HLINE);
+    term->put_glyph(top, x, TERM_GLYPH_HLINE);
+    term->put_glyph(top + height - 1, x, TERM_GLYPH_HLINE);
     x = x + 1;
   }
 
   int y = top + 1;
   while (y < top + height - 1) {
-    mvaddch(y, left, ACS_VLINE);
-    mvaddch(y, left + width - 1, ACS_VLINE);
+    term->put_glyph(y, left, TERM_GLYPH_VLINE);
+    term->put_glyph(y, left + width - 1, TERM_GLYPH_VLINE);
     y = y + 1;
   }
 }
@@ -194,20 +697,35 @@ void draw_border_classic(int top, int left, int rows, int cols, int cellw,
 
 void draw_matrix_classic(int top, int left, int **grid, int rows, int cols,
                          int cellw, int cellh) {
+  draw_matrix_cached(top, left, grid, rows, cols, cellw, cellh, 0);
+}
+
+
+void draw_matrix_cached(int top, int left, int **grid, int rows, int cols,
+                        int cellw, int cellh, int *shadow) {
+  draw_matrix_window(top, left, grid, 0, 0, rows, cols, cellw, cellh, shadow);
+}
+
+
+void draw_matrix_window(int top, int left, int **grid, int row0, int col0,
+                        int rows, int cols, int cellw, int cellh,
+                        int *shadow) {
+  const char *on = cellw >= 2 ? "[]" : "#";
+  const char *off = cellw >= 2 ? "  " : " ";
   int y = 0;
   while (y < rows) {
     int x = 0;
     while (x < cols) {
       int val = 0;
       if (grid != 0) {
-        val = grid[y][x];
+        val = grid[row0 + y][col0 + x];
       }
-      int px = left + 1 + x * cellw;
-      int py = top + 1 + y * cellh;
-      if (val != 0) {
-        mvprintw(py, px, "[]");
-      } else {
-        mvprintw(py, px, "  ");
+      int *seen = shadow != 0 ? &shadow[y * cols + x] : 0;
+      if (seen == 0 || *seen != val) {
+        int px = left + 1 + x * cellw;
+        int py = top + 1 + y * cellh;
+        term->put_text(py, px, val != 0 ? on : off);
+        if (seen != 0) *seen = val;
       }
       x = x + 1;
     }
@@ -220,13 +738,13 @@ void map_key_to_action(int ch, UserAction_t *act, int *hold) {
   *act = Action;
   *hold = 0;
 
-  if (ch == KEY_LEFT) {
+  if (ch == TERM_KEY_LEFT) {
     *act = Left;
-  } else if (ch == KEY_RIGHT) {
+  } else if (ch == TERM_KEY_RIGHT) {
     *act = Right;
-  } else if (ch == KEY_UP) {
+  } else if (ch == TERM_KEY_UP) {
     *act = Up;
-  } else if (ch == KEY_DOWN) {
+  } else if (ch == TERM_KEY_DOWN) {
     *act = Down;
     *hold = 1;
   } else if (ch == ' ') {
@@ -236,39 +754,46 @@ void map_key_to_action(int ch, UserAction_t *act, int *hold) {
     *act = Start;
   } else if (ch == 'p' || ch == 'P') {
     *act = Pause;
-  } else if (ch == 27 || ch == 'q' || ch == 'Q') {
+  } else if (ch == TERM_KEY_ESC || ch == 'q' || ch == 'Q') {
     *act = Terminate;
   }
 }
 
 
-int read_last_keypress(void) {
-  int ch = getch();
-  int last = -1;
-  while (ch != ERR) {
-    last = ch;
-    ch = getch();
+int read_key_events(KeyEvent *out, int max) {
+  int n = 0;
+  long long now = bg_clock_now_ns();
+  while (n < max) {
+    int ch = term->read_key();
+    if (ch == TERM_KEY_NONE) break;
+    out[n].ch = ch;
+    out[n].t_ns = now;
+    n = n + 1;
   }
-  return last;
+  return n;
 }
 
 
-void process_last_key(int last, int *action_down, int *quit_overlay) {
-  if (last == -1) return;
+void process_key_event(const KeyEvent *ev, int *action_down,
+                       int *quit_overlay) {
   UserAction_t a;
   int hold;
-  map_key_to_action(last, &a, &hold);
+  map_key_to_action(ev->ch, &a, &hold);
   if (a == Terminate) {
     *quit_overlay = 1;
   }
 
   if (a == Action && hold) {
     if (!(*action_down)) {
-      userInput(a, hold);
+      sim_post_input_at(a, hold, ev->t_ns);
       *action_down = 1;
     }
   } else {
-    userInput(a, hold);
-    if (a == Down) userInput(a, 0);
+    if (*action_down) {
+      sim_post_input_at(Action, 0, ev->t_ns);
+      *action_down = 0;
+    }
+    sim_post_input_at(a, hold, ev->t_ns);
+    if (a == Down) sim_post_input_at(a, 0, ev->t_ns);
   }
 }
@@ -2,26 +2,59 @@
 #define DRAW_H
 
 #include "brick_game_api.h"
+#include "latency.h"
+#include "term.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct {
+  int ch;
+  long long t_ns;
+} KeyEvent;
+
+typedef struct {
+  int focus_row;
+  int focus_col;
+  const unsigned *row_version;
+} DrawHints;
+
+void interface_use_backend(const TermBackend *backend);
+const TermBackend *interface_backend(void);
+void interface_present(void);
+void interface_use_virtual_time(int on);
 void interface_run(void);
 void console_loop(void);
 int step_and_draw_once(void);
-void interface_draw(const GameInfo_t *g);
+int present_latest_frame(void);
+void interface_draw(const GameInfo_t *g, int rows, int cols, int game_over);
+void interface_draw_hinted(const GameInfo_t *g, int rows, int cols,
+                           int game_over, const DrawHints *hints);
+void interface_invalidate(void);
+unsigned long long draw_frame_bytes(void);
+unsigned long long draw_total_bytes(void);
+const LatencyHist *interface_input_latency(void);
+void interface_toggle_overlay(void);
 void draw_game_over_banner_over_field(int top, int left, int rows, int cols,
                                       int cellw, int cellh);
 void draw_hud_classic(int top, int left, const GameInfo_t *g);
+void draw_hud_values(int top, int left, const GameInfo_t *g, int *shadow);
+void draw_hud_controls(int top, int left);
 void sleep_ms(int ms);
 void draw_border_classic(int top, int left, int rows, int cols, int cellw,
                          int cellh);
 void draw_matrix_classic(int top, int left, int **grid, int rows, int cols,
                          int cellw, int cellh);
+void draw_matrix_cached(int top, int left, int **grid, int rows, int cols,
+                        int cellw, int cellh, int *shadow);
+void draw_matrix_window(int top, int left, int **grid, int row0, int col0,
+                        int rows, int cols, int cellw, int cellh,
+                        int *shadow);
 void map_key_to_action(int ch, UserAction_t *act, int *hold);
-int read_last_keypress(void);
-void process_last_key(int last, int *action_down, int *quit_overlay);
+int read_key_events(KeyEvent *out, int max);
+void process_key_event(const KeyEvent *ev, int *action_down,
+                       int *quit_overlay);
 int t_take_terminate(void);
 
 #ifdef __cplusplus
@@ -0,0 +1,192 @@
+#include "headless.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "alloc_track.h"
+#include "bg_clock.h"
+#include "brick_game_api.h"
+#include "draw.h"
+#include "hw_counters.h"
+#include "replay.h"
+
+enum { HEADLESS_DEFAULT_FRAMES = 1000, HEADLESS_WARMUP_FRAMES = 64 };
+
+
+static int headless_load(const char *path, Replay *r) {
+  memset(r, 0, sizeof(*r));
+  if (path == 0) {
+    snprintf(r->game, sizeof(r->game), "%s", gameName());
+    return 1;
+  }
+  if (replay_load(path, r) == 0) {
+    fprintf(stderr, "cannot read replay: %s\n", path);
+    return 0;
+  }
+  if (r->game[0] != 0 && strcmp(r->game, gameName()) != 0) {
+    fprintf(stderr, "replay %s is for %s, not %s\n", path, r->game,
+            gameName());
+    replay_free(r);
+    return 0;
+  }
+  return 1;
+}
+
+
+typedef struct {
+  int frames;
+  int dirty_frames;
+  int first_step;
+  unsigned long long count;
+  unsigned long long bytes;
+  unsigned long long term_count;
+  unsigned long long term_bytes;
+} AllocReport;
+
+static const TermBackend *counted_term = 0;
+static TermBackend counted_backend;
+static unsigned long long counted_present_allocs = 0;
+static unsigned long long counted_present_bytes = 0;
+
+
+static unsigned long long counted_present(void) {
+  AllocScope scope;
+  alloc_scope_begin(&scope);
+  unsigned long long bytes = counted_term->present();
+  alloc_scope_end(&scope);
+  counted_present_allocs = counted_present_allocs + scope.count;
+  counted_present_bytes = counted_present_bytes + scope.bytes;
+  return bytes;
+}
+
+
+static const TermBackend *counted_backend_for(const TermBackend *term) {
+  counted_term = term;
+  counted_backend = *term;
+  counted_backend.present = counted_present;
+  return &counted_backend;
+}
+
+
+static void alloc_report_add(AllocReport *a, int step,
+                             const AllocScope *scope) {
+  a->frames = a->frames + 1;
+  a->term_count = a->term_count + counted_present_allocs;
+  a->term_bytes = a->term_bytes + counted_present_bytes;
+  if (scope->count == counted_present_allocs) return;
+  if (a->dirty_frames == 0) a->first_step = step;
+  a->dirty_frames = a->dirty_frames + 1;
+  a->count = a->count + scope->count - counted_present_allocs;
+  a->bytes = a->bytes + scope->bytes - counted_present_bytes;
+}
+
+
+int headless_run(const char *replay_path, int frames, int zero_alloc,
+                 int counters) {
+  if (zero_alloc != 0 && alloc_track_available() == 0) {
+    fprintf(stderr, "--zero-alloc needs the allocation hooks; rebuild with "
+                    "'make clean && make ALLOC_TRACK=1' on glibc\n");
+    return 2;
+  }
+  Replay r;
+  if (headless_load(replay_path, &r) == 0) return 2;
+  if (frames <= 0) frames = r.frames > 0 ? r.frames : HEADLESS_DEFAULT_FRAMES;
+
+  const TermBackend *term = term_ncurses_null_backend();
+  interface_use_backend(zero_alloc != 0 ? counted_backend_for(term) : term);
+  if (term->open() == 0) {
+    fprintf(stderr, "cannot open a null ncurses terminal\n");
+    replay_free(&r);
+    return 2;
+  }
+  interface_use_virtual_time(1);
+  setHighScorePersistence(0);
+  setRandomSeed(r.seed);
+
+  HwCounters hw;
+  HwSample hw_sample;
+  memset(&hw_sample, 0, sizeof(hw_sample));
+  if (counters != 0 && hw_counters_open(&hw) == 0) {
+    printf("counters: unavailable (%s)\n", strerror(hw.error));
+    hw_counters_close(&hw);
+    counters = 0;
+  }
+
+  if (counters != 0) hw_counters_start(&hw);
+  long long t0 = bg_clock_real_ns();
+  int step = 0;
+  int next = 0;
+  int running = 1;
+  AllocReport allocs = {0, 0, 0, 0, 0, 0, 0};
+  int warmup = frames < 2 * HEADLESS_WARMUP_FRAMES ? (frames + 1) / 2
+                                                   : HEADLESS_WARMUP_FRAMES;
+  while (running != 0 && step < frames) {
+    AllocScope scope;
+    int counted = zero_alloc != 0 && step >= warmup;
+    if (counted != 0) {
+      counted_present_allocs = 0;
+      counted_present_bytes = 0;
+      alloc_scope_begin(&scope);
+    }
+    while (next < r.count && r.events[next].step <= step) {
+      userInput(r.events[next].action, r.events[next].hold != 0);
+      next = next + 1;
+    }
+    running = step_and_draw_once();
+    if (counted != 0) {
+      alloc_scope_end(&scope);
+      alloc_report_add(&allocs, step, &scope);
+    }
+    step = step + 1;
+  }
+  long long wall_ns = bg_clock_real_ns() - t0;
+  if (counters != 0) {
+    hw_counters_stop(&hw, &hw_sample);
+    hw_counters_close(&hw);
+  }
+
+  GameInfo_t g = updateCurrentState();
+  int score = g.score;
+  freeGameInfo(&g);
+  int over = isGameOver();
+  term->close();
+  interface_use_virtual_time(0);
+
+  double per_frame_us = step > 0 ? (double)wall_ns / step / 1000.0 : 0.0;
+  printf("headless game=%s frames=%d wall=%.3f ms %.2f us/frame "
+         "%.0f frames/s bytes=%llu score=%d over=%d\n",
+         gameName(), step, (double)wall_ns / 1e6, per_frame_us,
+         per_frame_us > 0.0 ? 1e6 / per_frame_us : 0.0, draw_total_bytes(),
+         score, over);
+
+  if (counters != 0) {
+    printf("counters:");
+    hw_sample_print(&hw_sample, (double)step, "frame", stdout);
+    printf("\n");
+  }
+
+  int status = 0;
+  if (r.has_end != 0 && (r.end_frames != step || r.end_score != score ||
+                         r.end_over != over)) {
+    printf("replay mismatch: expected end %d score %d over %d\n",
+           r.end_frames, r.end_score, r.end_over);
+    status = 1;
+  }
+  if (zero_alloc != 0 && allocs.frames == 0) {
+    printf("zero-alloc: no steady-state frames measured (run ended at frame "
+           "%d, warm-up is %d frames)\n",
+           step, warmup);
+    status = 1;
+  } else if (zero_alloc != 0) {
+    printf("zero-alloc: %d of %d frames allocated (%llu allocs, %llu bytes)",
+           allocs.dirty_frames, allocs.frames, allocs.count, allocs.bytes);
+    if (allocs.dirty_frames != 0) {
+      printf(", first at frame %d", allocs.first_step);
+    }
+    printf("; %llu more (%llu bytes) inside the terminal library\n",
+           allocs.term_count, allocs.term_bytes);
+    if (allocs.dirty_frames != 0) status = 1;
+  }
+  replay_free(&r);
+  return status;
+}
@@ -0,0 +1,15 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int headless_run(const char *replay_path, int frames, int zero_alloc,
+                 int counters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
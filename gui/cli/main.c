@@ -1,6 +1,102 @@
-void interface_run(void);
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-int main(void) {
-  interface_run();
-  return 0;
+#include "dashboard.h"
+#include "draw.h"
+#include "headless.h"
+#include "record.h"
+#include "trace.h"
+
+int main(int argc, char **argv) {
+  int multi = 0;
+  int fps = 30;
+  int headless = 0;
+  int frames = 0;
+  const char *replay = 0;
+  const char *record = 0;
+  const char *play = 0;
+  double speed = 1.0;
+  const char *fsm_stats = 0;
+  const char *trace = 0;
+  int latency = 0;
+  int zero_alloc = 0;
+  int counters = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--ansi") == 0) {
+      interface_use_backend(term_ansi_backend());
+    } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      int rows = 0, cols = 0;
+      if (sscanf(argv[++i], "%dx%d", &rows, &cols) != 2 ||
+          setFieldSize(rows, cols) == 0) {
+        fprintf(stderr, "unsupported board size: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--multi") == 0 && i + 1 < argc) {
+      multi = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+      fps = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--headless") == 0) {
+      headless = 1;
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay = argv[++i];
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      record = argv[++i];
+    } else if (strcmp(argv[i], "--play") == 0 && i + 1 < argc) {
+      play = argv[++i];
+    } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      speed = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--fsm-stats") == 0 && i + 1 < argc) {
+      fsm_stats = argv[++i];
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      trace = argv[++i];
+    } else if (strcmp(argv[i], "--latency") == 0) {
+      latency = 1;
+    } else if (strcmp(argv[i], "--zero-alloc") == 0) {
+      zero_alloc = 1;
+    } else if (strcmp(argv[i], "--counters") == 0) {
+      counters = 1;
+    }
+  }
+  if (fsm_stats != 0 && (play != 0 || (headless == 0 && multi > 0))) {
+    fprintf(stderr, "--fsm-stats cannot be combined with %s\n",
+            play != 0 ? "--play" : "--multi");
+    return 2;
+  }
+  if (trace != 0) {
+    if (trace_start(trace) == 0) {
+      fprintf(stderr, "cannot trace to %s\n", trace);
+      return 2;
+    }
+    trace_thread_name("main");
+  }
+  if (latency != 0) latency_watch_signal();
+  int rc = 0;
+  if (play != 0) {
+    rc = record_play(play, speed);
+  } else if (headless != 0) {
+    rc = headless_run(replay, frames, zero_alloc, counters);
+  } else if (multi > 0) {
+    dashboard_run(multi, fps);
+  } else if (record != 0 && record_start(record) == 0) {
+    fprintf(stderr, "cannot record to %s\n", record);
+    rc = 2;
+  } else {
+    interface_run();
+    record_stop();
+    if (latency != 0) {
+      latency_print(interface_input_latency(), "input-latency", stderr);
+    }
+  }
+  if (fsm_stats != 0 && dumpFsmStats(fsm_stats) == 0) {
+    fprintf(stderr, "fsm stats not written to %s (build with FSM_STATS=1)\n",
+            fsm_stats);
+  }
+  trace_stop();
+  if (trace != 0 && trace_dropped() != 0) {
+    fprintf(stderr, "trace dropped %llu events\n", trace_dropped());
+  }
+  return rc;
 }
@@ -0,0 +1,644 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "record.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include "bg_clock.h"
+#include "draw.h"
+#include "trace.h"
+
+enum {
+  REC_HUD = 9,
+  REC_MIN_RING = 1 << 20,
+  REC_FLAG_HUD = 1,
+  REC_FLAG_SIZE = 2,
+  REC_MAX_DIM = 1024
+};
+
+static const unsigned char REC_MAGIC[6] = {'B', 'G', 'R', 'E', 'C', 1};
+
+typedef struct {
+  uint32_t size;
+  uint32_t changed;
+  int64_t t_ns;
+  int32_t rows;
+  int32_t cols;
+  int32_t hud[REC_HUD];
+} RecHeader;
+
+typedef struct {
+  unsigned char *data;
+  size_t len;
+  size_t cap;
+} ByteBuf;
+
+typedef struct {
+  unsigned char *buf;
+  size_t cap;
+  atomic_size_t head;
+  atomic_size_t tail;
+} RecRing;
+
+typedef struct {
+  int rd;
+  int wr;
+} RecSignal;
+
+typedef struct {
+  RecRing ring;
+  FILE *out;
+  pthread_t thread;
+  atomic_int running;
+  atomic_int idle;
+  RecSignal wake;
+  int active;
+
+  unsigned *pushed;
+  unsigned char *row_bytes;
+  int rows;
+  int cols;
+  int resync;
+  unsigned long long dropped;
+
+  unsigned char *shadow;
+  unsigned char *row_in;
+  int shadow_rows;
+  int shadow_cols;
+  int32_t hud[REC_HUD];
+  int64_t last_ns;
+  ByteBuf frame;
+  ByteBuf runs;
+} Recorder;
+
+static Recorder rec;
+
+
+static int signal_open(RecSignal *sig) {
+#ifdef __linux__
+  sig->rd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  sig->wr = sig->rd;
+  return sig->rd >= 0;
+#else
+  int fds[2];
+  if (pipe(fds) != 0) return 0;
+  for (int i = 0; i < 2; ++i) {
+    fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+  }
+  sig->rd = fds[0];
+  sig->wr = fds[1];
+  return 1;
+#endif
+}
+
+
+static void signal_close(RecSignal *sig) {
+  if (sig->rd >= 0) close(sig->rd);
+  if (sig->wr >= 0 && sig->wr != sig->rd) close(sig->wr);
+  sig->rd = -1;
+  sig->wr = -1;
+}
+
+
+static void signal_raise(RecSignal *sig) {
+  uint64_t one = 1;
+  ssize_t n = write(sig->wr, &one, sizeof(one));
+  (void)n;
+}
+
+
+static void signal_drain(RecSignal *sig) {
+  uint64_t buf[8];
+  while (read(sig->rd, buf, sizeof(buf)) > 0) {
+  }
+}
+
+
+static int buf_reserve(ByteBuf *b, size_t extra) {
+  if (b->len + extra <= b->cap) return 1;
+  size_t cap = b->cap ? b->cap : 256;
+  while (cap < b->len + extra) cap *= 2;
+  unsigned char *grown = (unsigned char *)realloc(b->data, cap);
+  if (grown == 0) return 0;
+  b->data = grown;
+  b->cap = cap;
+  return 1;
+}
+
+
+static void buf_bytes(ByteBuf *b, const unsigned char *src, size_t n) {
+  if (buf_reserve(b, n) == 0) return;
+  memcpy(b->data + b->len, src, n);
+  b->len += n;
+}
+
+
+static void buf_uvar(ByteBuf *b, uint64_t v) {
+  unsigned char tmp[10];
+  size_t n = 0;
+  while (v >= 0x80) {
+    tmp[n++] = (unsigned char)(v | 0x80);
+    v >>= 7;
+  }
+  tmp[n++] = (unsigned char)v;
+  buf_bytes(b, tmp, n);
+}
+
+
+static void buf_svar(ByteBuf *b, int64_t v) {
+  buf_uvar(b, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+
+static void ring_write_at(size_t pos, const void *src, size_t n) {
+  size_t off = pos & (rec.ring.cap - 1);
+  size_t first = n < rec.ring.cap - off ? n : rec.ring.cap - off;
+  memcpy(rec.ring.buf + off, src, first);
+  memcpy(rec.ring.buf, (const unsigned char *)src + first, n - first);
+}
+
+
+static void ring_read_at(size_t pos, void *dst, size_t n) {
+  size_t off = pos & (rec.ring.cap - 1);
+  size_t first = n < rec.ring.cap - off ? n : rec.ring.cap - off;
+  memcpy(dst, rec.ring.buf + off, first);
+  memcpy((unsigned char *)dst + first, rec.ring.buf, n - first);
+}
+
+
+static int rec_resize_shadow(int rows, int cols) {
+  size_t count = (size_t)rows * (size_t)cols;
+  free(rec.shadow);
+  free(rec.row_in);
+  rec.shadow = (unsigned char *)calloc(count > 0 ? count : 1, 1);
+  rec.row_in = (unsigned char *)malloc((size_t)(cols > 0 ? cols : 1));
+  rec.shadow_rows = rows;
+  rec.shadow_cols = cols;
+  return rec.shadow != 0 && rec.row_in != 0;
+}
+
+
+static size_t rec_encode_runs(const RecHeader *h, size_t pos) {
+  size_t runs = 0;
+  size_t prev_end = 0;
+  int cols = h->cols;
+  for (uint32_t i = 0; i < h->changed; ++i) {
+    int32_t r = 0;
+    ring_read_at(pos, &r, sizeof(r));
+    ring_read_at(pos + sizeof(r), rec.row_in, (size_t)cols);
+    pos += sizeof(r) + (size_t)cols;
+    unsigned char *seen = rec.shadow + (size_t)r * (size_t)cols;
+    int c = 0;
+    while (c < cols) {
+      if (rec.row_in[c] == seen[c]) {
+        c = c + 1;
+        continue;
+      }
+      int start = c;
+      while (c < cols && rec.row_in[c] != seen[c]) c = c + 1;
+      size_t index = (size_t)r * (size_t)cols + (size_t)start;
+      buf_uvar(&rec.runs, index - prev_end);
+      buf_uvar(&rec.runs, (uint64_t)(c - start));
+      buf_bytes(&rec.runs, rec.row_in + start, (size_t)(c - start));
+      memcpy(seen + start, rec.row_in + start, (size_t)(c - start));
+      prev_end = index + (size_t)(c - start);
+      runs = runs + 1;
+    }
+  }
+  return runs;
+}
+
+
+static void rec_encode(const RecHeader *h, size_t pos) {
+  unsigned flags = 0;
+  if (h->rows != rec.shadow_rows || h->cols != rec.shadow_cols) {
+    if (rec_resize_shadow(h->rows, h->cols) == 0) return;
+    flags |= REC_FLAG_SIZE | REC_FLAG_HUD;
+  }
+  if (memcmp(h->hud, rec.hud, sizeof(rec.hud)) != 0) flags |= REC_FLAG_HUD;
+
+  rec.runs.len = 0;
+  size_t runs = rec_encode_runs(h, pos);
+  if (flags == 0 && runs == 0) return;
+
+  rec.frame.len = 0;
+  int64_t dt = rec.last_ns != 0 ? h->t_ns - rec.last_ns : 0;
+  buf_uvar(&rec.frame, (uint64_t)(dt > 0 ? dt / 1000 : 0));
+  buf_uvar(&rec.frame, flags);
+  if (flags & REC_FLAG_SIZE) {
+    buf_uvar(&rec.frame, (uint64_t)h->rows);
+    buf_uvar(&rec.frame, (uint64_t)h->cols);
+  }
+  if (flags & REC_FLAG_HUD) {
+    for (int i = 0; i < REC_HUD; ++i) buf_svar(&rec.frame, h->hud[i]);
+    memcpy(rec.hud, h->hud, sizeof(rec.hud));
+  }
+  buf_uvar(&rec.frame, runs);
+  buf_bytes(&rec.frame, rec.runs.data, rec.runs.len);
+  fwrite(rec.frame.data, 1, rec.frame.len, rec.out);
+  rec.last_ns = h->t_ns;
+}
+
+
+static void *rec_thread_main(void *arg) {
+  (void)arg;
+  trace_thread_name("record");
+  int running = 1;
+  while (running != 0) {
+    running = atomic_load(&rec.running);
+    size_t tail = atomic_load_explicit(&rec.ring.tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&rec.ring.head, memory_order_acquire);
+    while (tail != head) {
+      RecHeader h;
+      ring_read_at(tail, &h, sizeof(h));
+      rec_encode(&h, tail + sizeof(h));
+      tail += h.size;
+      atomic_store_explicit(&rec.ring.tail, tail, memory_order_release);
+    }
+    if (running != 0) {
+      atomic_store(&rec.idle, 1);
+      if (atomic_load(&rec.ring.head) == tail && atomic_load(&rec.running)) {
+        struct pollfd pfd = {rec.wake.rd, POLLIN, 0};
+        poll(&pfd, 1, -1);
+      }
+      atomic_store(&rec.idle, 0);
+      signal_drain(&rec.wake);
+    }
+  }
+  return 0;
+}
+
+
+int record_start(const char *path) {
+  if (rec.active != 0) return 1;
+  int rows = 0, cols = 0;
+  getFieldSize(&rows, &cols);
+  size_t need = 2 * (sizeof(RecHeader) +
+                     (size_t)rows * (sizeof(int32_t) + (size_t)cols));
+  size_t cap = REC_MIN_RING;
+  while (cap < need) cap *= 2;
+
+  memset(&rec, 0, sizeof(rec));
+  rec.wake.rd = -1;
+  rec.wake.wr = -1;
+  rec.out = fopen(path, "wb");
+  rec.ring.buf = (unsigned char *)malloc(cap);
+  if (rec.out == 0 || rec.ring.buf == 0 || signal_open(&rec.wake) == 0) {
+    if (rec.out != 0) fclose(rec.out);
+    free(rec.ring.buf);
+    signal_close(&rec.wake);
+    memset(&rec, 0, sizeof(rec));
+    return 0;
+  }
+  rec.ring.cap = cap;
+  rec.shadow_rows = -1;
+  rec.resync = 1;
+  fwrite(REC_MAGIC, 1, sizeof(REC_MAGIC), rec.out);
+  atomic_store(&rec.running, 1);
+  if (pthread_create(&rec.thread, 0, rec_thread_main, 0) != 0) {
+    fclose(rec.out);
+    free(rec.ring.buf);
+    signal_close(&rec.wake);
+    memset(&rec, 0, sizeof(rec));
+    return 0;
+  }
+  rec.active = 1;
+  return 1;
+}
+
+
+static int rec_prepare_rows(int rows, int cols) {
+  if (rows == rec.rows && cols == rec.cols && rec.pushed != 0) return 1;
+  free(rec.pushed);
+  free(rec.row_bytes);
+  rec.pushed = (unsigned *)calloc((size_t)(rows > 0 ? rows : 1),
+                                  sizeof(unsigned));
+  rec.row_bytes = (unsigned char *)malloc((size_t)(cols > 0 ? cols : 1));
+  rec.rows = rows;
+  rec.cols = cols;
+  rec.resync = 1;
+  return rec.pushed != 0 && rec.row_bytes != 0;
+}
+
+
+void record_frame(const SimFrame *f) {
+  if (rec.active == 0 || f == 0 || f->field == 0) return;
+  if (rec_prepare_rows(f->rows, f->cols) == 0) return;
+
+  uint32_t changed = 0;
+  for (int r = 0; r < f->rows; ++r) {
+    if (rec.resync != 0 || f->row_version == 0 ||
+        rec.pushed[r] != f->row_version[r]) {
+      changed = changed + 1;
+    }
+  }
+  size_t total = sizeof(RecHeader) +
+                 (size_t)changed * (sizeof(int32_t) + (size_t)f->cols);
+  size_t head = atomic_load_explicit(&rec.ring.head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&rec.ring.tail, memory_order_acquire);
+  if (total > rec.ring.cap - (head - tail)) {
+    rec.dropped = rec.dropped + 1;
+    rec.resync = 1;
+    return;
+  }
+
+  RecHeader h;
+  memset(&h, 0, sizeof(h));
+  h.size = (uint32_t)total;
+  h.changed = changed;
+  h.t_ns = bg_clock_now_ns();
+  h.rows = f->rows;
+  h.cols = f->cols;
+  int next_mask = 0;
+  for (int i = 0; i < 16; ++i) {
+    if (f->next_cells[i] != 0) next_mask |= 1 << i;
+  }
+  int32_t hud[REC_HUD] = {f->score, f->high_score, f->level,
+                          f->speed, f->pause,      f->game_over,
+                          f->focus_row, f->focus_col, next_mask};
+  memcpy(h.hud, hud, sizeof(hud));
+  ring_write_at(head, &h, sizeof(h));
+
+  size_t pos = head + sizeof(h);
+  for (int r = 0; r < f->rows; ++r) {
+    unsigned version = f->row_version != 0 ? f->row_version[r] : 0;
+    if (rec.resync == 0 && f->row_version != 0 && rec.pushed[r] == version) {
+      continue;
+    }
+    int32_t row = r;
+    for (int c = 0; c < f->cols; ++c) {
+      int v = f->field[r][c];
+      rec.row_bytes[c] = (unsigned char)(v < 0 ? 0 : v > 255 ? 255 : v);
+    }
+    ring_write_at(pos, &row, sizeof(row));
+    ring_write_at(pos + sizeof(row), rec.row_bytes, (size_t)f->cols);
+    pos += sizeof(row) + (size_t)f->cols;
+    rec.pushed[r] = version;
+  }
+  atomic_store(&rec.ring.head, head + total);
+  if (atomic_exchange(&rec.idle, 0) != 0) signal_raise(&rec.wake);
+  rec.resync = 0;
+}
+
+
+unsigned long long record_dropped(void) { return rec.dropped; }
+
+
+void record_stop(void) {
+  if (rec.active == 0) return;
+  atomic_store(&rec.running, 0);
+  signal_raise(&rec.wake);
+  pthread_join(rec.thread, 0);
+  signal_close(&rec.wake);
+  fclose(rec.out);
+  free(rec.ring.buf);
+  free(rec.pushed);
+  free(rec.row_bytes);
+  free(rec.shadow);
+  free(rec.row_in);
+  free(rec.frame.data);
+  free(rec.runs.data);
+  memset(&rec, 0, sizeof(rec));
+}
+
+
+typedef struct {
+  const unsigned char *data;
+  size_t len;
+  size_t pos;
+  int ok;
+} RecReader;
+
+
+static uint64_t read_uvar(RecReader *in) {
+  uint64_t v = 0;
+  int shift = 0;
+  while (in->ok != 0) {
+    if (in->pos >= in->len || shift > 63) {
+      in->ok = 0;
+      break;
+    }
+    unsigned char b = in->data[in->pos++];
+    v |= (uint64_t)(b & 0x7F) << shift;
+    if ((b & 0x80) == 0) break;
+    shift += 7;
+  }
+  return in->ok != 0 ? v : 0;
+}
+
+
+static int64_t read_svar(RecReader *in) {
+  uint64_t v = read_uvar(in);
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+
+typedef struct {
+  int rows;
+  int cols;
+  int *cells;
+  int **field;
+  unsigned *versions;
+  int next_cells[16];
+  int *next[4];
+  int hud[REC_HUD];
+} PlayState;
+
+
+static int play_resize(PlayState *p, int rows, int cols) {
+  size_t count = (size_t)rows * (size_t)cols;
+  free(p->cells);
+  free(p->field);
+  free(p->versions);
+  p->cells = (int *)calloc(count > 0 ? count : 1, sizeof(int));
+  p->field = (int **)malloc(sizeof(int *) * (size_t)(rows > 0 ? rows : 1));
+  p->versions = (unsigned *)calloc((size_t)(rows > 0 ? rows : 1),
+                                   sizeof(unsigned));
+  if (p->cells == 0 || p->field == 0 || p->versions == 0) return 0;
+  for (int r = 0; r < rows; ++r) p->field[r] = p->cells + (size_t)r * cols;
+  for (int r = 0; r < 4; ++r) p->next[r] = p->next_cells + r * 4;
+  p->rows = rows;
+  p->cols = cols;
+  return 1;
+}
+
+
+/* With apply == 0 the frame is only validated, so a corrupt frame is
+ * rejected before any of it reaches the play state. */
+static long long play_decode(RecReader *in, PlayState *p, int apply) {
+  long long dt_us = (long long)read_uvar(in);
+  unsigned flags = (unsigned)read_uvar(in);
+  int rows = p->rows;
+  int cols = p->cols;
+  if (flags & REC_FLAG_SIZE) {
+    uint64_t r = read_uvar(in);
+    uint64_t c = read_uvar(in);
+    if (r == 0 || c == 0 || r > REC_MAX_DIM || c > REC_MAX_DIM) in->ok = 0;
+    rows = (int)r;
+    cols = (int)c;
+    if (in->ok != 0 && apply != 0 && play_resize(p, rows, cols) == 0) {
+      in->ok = 0;
+    }
+  }
+  int hud[REC_HUD];
+  if (flags & REC_FLAG_HUD) {
+    for (int i = 0; i < REC_HUD; ++i) hud[i] = (int)read_svar(in);
+    if (in->ok != 0 && apply != 0) {
+      memcpy(p->hud, hud, sizeof(hud));
+      for (int i = 0; i < 16; ++i) p->next_cells[i] = (p->hud[8] >> i) & 1;
+    }
+  }
+  size_t runs = (size_t)read_uvar(in);
+  size_t index = 0;
+  size_t count = in->ok != 0 ? (size_t)rows * (size_t)cols : 0;
+  for (size_t i = 0; in->ok != 0 && i < runs; ++i) {
+    size_t skip = (size_t)read_uvar(in);
+    size_t n = (size_t)read_uvar(in);
+    if (in->ok == 0 || n == 0 || skip > count - index ||
+        n > count - index - skip || n > in->len - in->pos) {
+      in->ok = 0;
+      break;
+    }
+    index += skip;
+    if (apply != 0) {
+      for (size_t k = 0; k < n; ++k) {
+        p->cells[index + k] = in->data[in->pos + k];
+      }
+      for (size_t r = index / (size_t)cols; r <= (index + n - 1) / (size_t)cols;
+           ++r) {
+        p->versions[r] += 1;
+      }
+    }
+    in->pos += n;
+    index += n;
+  }
+  return dt_us;
+}
+
+
+static int play_wait(long long *due_ns, double *speed, int *paused) {
+  const TermBackend *term = interface_backend();
+  int running = 1;
+  long long paused_at = bg_clock_now_ns();
+  while (running != 0) {
+    long long left = *due_ns - bg_clock_now_ns();
+    if (*paused == 0 && left <= 0) break;
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    int timeout = *paused != 0 ? -1 : (int)((left + 999999LL) / 1000000LL);
+    poll(&pfd, 1, timeout);
+    int ch = term->read_key();
+    while (ch != TERM_KEY_NONE) {
+      if (ch == 'q' || ch == 'Q' || ch == TERM_KEY_ESC) running = 0;
+      if (ch == ' ' || ch == 'p' || ch == 'P') {
+        long long now = bg_clock_now_ns();
+        if (*paused != 0) *due_ns += now - paused_at;
+        paused_at = now;
+        *paused = !*paused;
+      }
+      if (ch == '+' || ch == '=') *speed = *speed * 2.0;
+      if (ch == '-' && *speed > 1.0 / 64.0) *speed = *speed / 2.0;
+      if (ch == TERM_KEY_RESIZE) interface_invalidate();
+      ch = term->read_key();
+    }
+  }
+  return running;
+}
+
+
+static unsigned char *read_file(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (f == 0) return 0;
+  size_t cap = 1 << 16;
+  size_t n = 0;
+  unsigned char *data = (unsigned char *)malloc(cap);
+  while (data != 0) {
+    n += fread(data + n, 1, cap - n, f);
+    if (n < cap) break;
+    unsigned char *grown = (unsigned char *)realloc(data, cap * 2);
+    if (grown == 0) {
+      free(data);
+      data = 0;
+    } else {
+      data = grown;
+      cap *= 2;
+    }
+  }
+  fclose(f);
+  *len = n;
+  return data;
+}
+
+
+int record_play(const char *path, double speed) {
+  size_t len = 0;
+  unsigned char *data = read_file(path, &len);
+  if (data == 0 || len < sizeof(REC_MAGIC) ||
+      memcmp(data, REC_MAGIC, sizeof(REC_MAGIC)) != 0) {
+    fprintf(stderr, "not a recording: %s\n", path);
+    free(data);
+    return 2;
+  }
+  const TermBackend *term = interface_backend();
+  if (term->open() == 0) {
+    free(data);
+    return 2;
+  }
+
+  PlayState p;
+  memset(&p, 0, sizeof(p));
+  RecReader in = {data, len, sizeof(REC_MAGIC), 1};
+  int paused = 0;
+  int running = 1;
+  long long due_ns = bg_clock_now_ns();
+  while (running != 0 && in.pos < in.len) {
+    RecReader probe = in;
+    play_decode(&probe, &p, 0);
+    if (probe.ok == 0) {
+      in.ok = 0;
+      break;
+    }
+    long long dt_us = play_decode(&in, &p, 1);
+    if (in.ok == 0 || p.cells == 0) break;
+    if (speed > 0.0) due_ns += (long long)((double)dt_us * 1000.0 / speed);
+    running = play_wait(&due_ns, &speed, &paused);
+    if (speed <= 0.0 || due_ns < bg_clock_now_ns() - 1000000000LL) {
+      due_ns = bg_clock_now_ns();
+    }
+
+    GameInfo_t g;
+    memset(&g, 0, sizeof(g));
+    g.field = p.field;
+    g.next = p.next;
+    g.score = p.hud[0];
+    g.high_score = p.hud[1];
+    g.level = p.hud[2];
+    g.speed = p.hud[3];
+    g.pause = p.hud[4];
+    DrawHints hints = {p.hud[6], p.hud[7], p.versions};
+    interface_draw_hinted(&g, p.rows, p.cols, p.hud[5], &hints);
+  }
+  if (running != 0) sleep_ms(800);
+  term->close();
+  free(p.cells);
+  free(p.field);
+  free(p.versions);
+  free(data);
+  if (in.ok == 0) {
+    fprintf(stderr, "not a recording: %s\n", path);
+    return 2;
+  }
+  return 0;
+}
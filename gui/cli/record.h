@@ -0,0 +1,20 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include "sim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int record_start(const char *path);
+void record_frame(const SimFrame *f);
+void record_stop(void);
+unsigned long long record_dropped(void);
+int record_play(const char *path, double speed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef TERM_H
+#define TERM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+  TERM_KEY_NONE = -1,
+  TERM_KEY_ESC = 27,
+  TERM_KEY_LEFT = 0x1000,
+  TERM_KEY_RIGHT,
+  TERM_KEY_UP,
+  TERM_KEY_DOWN,
+  TERM_KEY_RESIZE
+};
+
+typedef enum {
+  TERM_GLYPH_ULCORNER = 0,
+  TERM_GLYPH_URCORNER,
+  TERM_GLYPH_LLCORNER,
+  TERM_GLYPH_LRCORNER,
+  TERM_GLYPH_HLINE,
+  TERM_GLYPH_VLINE
+} TermGlyph;
+
+typedef struct {
+  const char *name;
+  int (*open)(void);
+  void (*close)(void);
+  void (*clear)(void);
+  void (*put_text)(int y, int x, const char *s);
+  void (*put_glyph)(int y, int x, TermGlyph g);
+  void (*put_braille)(int y, int x, unsigned dots);
+  void (*clear_eol)(int y, int x);
+  void (*set_bold)(int on);
+  unsigned long long (*present)(void);
+  void (*count_output)(int on);
+  int (*read_key)(void);
+  void (*size)(int *rows, int *cols);
+} TermBackend;
+
+const TermBackend *term_ncurses_backend(void);
+const TermBackend *term_ncurses_null_backend(void);
+const TermBackend *term_ansi_backend(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,406 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "term.h"
+
+enum {
+  ANSI_GLYPH = 0x100,
+  ANSI_BRAILLE = 0x2800,
+  ANSI_SKIP_MAX = 4,
+  ANSI_ESC_WAIT_MS = 50
+};
+
+typedef struct {
+  unsigned short ch;
+  unsigned char bold;
+} AnsiCell;
+
+typedef struct {
+  int rows;
+  int cols;
+  AnsiCell *front;
+  AnsiCell *back;
+  unsigned char bold;
+
+  char *out;
+  size_t out_len;
+  size_t out_cap;
+  int cur_y;
+  int cur_x;
+  int cur_bold;
+
+  unsigned char in[64];
+  int in_len;
+  int in_pos;
+
+  struct termios saved;
+  int active;
+} AnsiTerm;
+
+static AnsiTerm ansi;
+static volatile sig_atomic_t ansi_resized = 0;
+
+static const char *const GLYPHS[] = {"\xe2\x94\x8c", "\xe2\x94\x90",
+                                     "\xe2\x94\x94", "\xe2\x94\x98",
+                                     "\xe2\x94\x80", "\xe2\x94\x82"};
+
+static const char RESTORE_SEQ[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+
+
+static void out_reserve(size_t extra) {
+  if (ansi.out_len + extra <= ansi.out_cap) return;
+  size_t cap = ansi.out_cap ? ansi.out_cap : 4096;
+  while (cap < ansi.out_len + extra) cap *= 2;
+  char *grown = (char *)realloc(ansi.out, cap);
+  if (grown == 0) return;
+  ansi.out = grown;
+  ansi.out_cap = cap;
+}
+
+
+static void out_bytes(const char *s, size_t n) {
+  out_reserve(n);
+  if (ansi.out_len + n > ansi.out_cap) return;
+  memcpy(ansi.out + ansi.out_len, s, n);
+  ansi.out_len += n;
+}
+
+
+static void out_str(const char *s) { out_bytes(s, strlen(s)); }
+
+
+static void out_csi(int a, int b, char cmd) {
+  char seq[32];
+  int n = 0;
+  if (b >= 0)
+    n = snprintf(seq, sizeof(seq), "\x1b[%d;%d%c", a, b, cmd);
+  else if (a > 1)
+    n = snprintf(seq, sizeof(seq), "\x1b[%d%c", a, cmd);
+  else
+    n = snprintf(seq, sizeof(seq), "\x1b[%c", cmd);
+  out_bytes(seq, (size_t)n);
+}
+
+
+static size_t out_flush(void) {
+  size_t done = 0;
+  while (done < ansi.out_len) {
+    ssize_t n = write(STDOUT_FILENO, ansi.out + done, ansi.out_len - done);
+    if (n <= 0) break;
+    done += (size_t)n;
+  }
+  ansi.out_len = 0;
+  return done;
+}
+
+
+static void screen_fill(AnsiCell *cells, size_t count, unsigned short ch) {
+  for (size_t i = 0; i < count; ++i) {
+    cells[i].ch = ch;
+    cells[i].bold = 0;
+  }
+}
+
+
+static void screen_resize(void) {
+  struct winsize ws;
+  int rows = 24, cols = 80;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 &&
+      ws.ws_col > 0) {
+    rows = ws.ws_row;
+    cols = ws.ws_col;
+  }
+  size_t count = (size_t)rows * (size_t)cols;
+  AnsiCell *front = (AnsiCell *)realloc(ansi.front, sizeof(AnsiCell) * count);
+  if (front != 0) ansi.front = front;
+  AnsiCell *back = (AnsiCell *)realloc(ansi.back, sizeof(AnsiCell) * count);
+  if (back != 0) ansi.back = back;
+  if (front == 0 || back == 0) return;
+  ansi.rows = rows;
+  ansi.cols = cols;
+  screen_fill(ansi.front, count, ' ');
+  screen_fill(ansi.back, count, ' ');
+  out_str("\x1b[0m\x1b[2J");
+  ansi.cur_y = -1;
+  ansi.cur_x = -1;
+  ansi.cur_bold = 0;
+}
+
+
+static void ansi_restore(void) {
+  ssize_t n = write(STDOUT_FILENO, RESTORE_SEQ, sizeof(RESTORE_SEQ) - 1);
+  (void)n;
+  tcsetattr(STDIN_FILENO, TCSAFLUSH, &ansi.saved);
+}
+
+
+static void ansi_on_signal(int sig) {
+  if (ansi.active != 0) ansi_restore();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+
+static void ansi_on_winch(int sig) {
+  (void)sig;
+  ansi_resized = 1;
+}
+
+
+static int ansi_open(void) {
+  if (tcgetattr(STDIN_FILENO, &ansi.saved) != 0) return 0;
+  struct termios raw = ansi.saved;
+  raw.c_lflag &= ~(tcflag_t)(ICANON | ECHO);
+  raw.c_iflag &= ~(tcflag_t)(IXON | ICRNL);
+  raw.c_cc[VMIN] = 0;
+  raw.c_cc[VTIME] = 0;
+  if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0) return 0;
+  ansi.active = 1;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = ansi_on_signal;
+  sigaction(SIGINT, &sa, 0);
+  sigaction(SIGTERM, &sa, 0);
+  sa.sa_handler = ansi_on_winch;
+  sigaction(SIGWINCH, &sa, 0);
+
+  ansi.bold = 0;
+  ansi.in_len = 0;
+  ansi.in_pos = 0;
+  out_str("\x1b[?1049h\x1b[?25l");
+  screen_resize();
+  out_flush();
+  return 1;
+}
+
+
+static void ansi_close(void) {
+  if (ansi.active == 0) return;
+  out_flush();
+  ansi_restore();
+  ansi.active = 0;
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  signal(SIGWINCH, SIG_DFL);
+  free(ansi.front);
+  free(ansi.back);
+  free(ansi.out);
+  memset(&ansi, 0, sizeof(ansi));
+}
+
+
+static void ansi_clear(void) {
+  screen_fill(ansi.back, (size_t)ansi.rows * (size_t)ansi.cols, ' ');
+}
+
+
+static void put_cell(int y, int x, unsigned short ch) {
+  if (y < 0 || y >= ansi.rows || x < 0 || x >= ansi.cols) return;
+  AnsiCell *c = &ansi.back[(size_t)y * (size_t)ansi.cols + (size_t)x];
+  c->ch = ch;
+  c->bold = ansi.bold;
+}
+
+
+static void ansi_put_text(int y, int x, const char *s) {
+  for (int i = 0; s[i] != 0; ++i) {
+    unsigned char b = (unsigned char)s[i];
+    put_cell(y, x + i, b < 0x80 ? b : '?');
+  }
+}
+
+
+static void ansi_put_glyph(int y, int x, TermGlyph g) {
+  put_cell(y, x, (unsigned short)(ANSI_GLYPH + g));
+}
+
+
+static void ansi_put_braille(int y, int x, unsigned dots) {
+  put_cell(y, x, (unsigned short)(ANSI_BRAILLE + (dots & 0xFFu)));
+}
+
+
+static void ansi_clear_eol(int y, int x) {
+  unsigned char bold = ansi.bold;
+  ansi.bold = 0;
+  for (int i = x; i < ansi.cols; ++i) put_cell(y, i, ' ');
+  ansi.bold = bold;
+}
+
+
+static void ansi_set_bold(int on) { ansi.bold = on != 0 ? 1 : 0; }
+
+
+static int cell_same(const AnsiCell *a, const AnsiCell *b) {
+  return a->ch == b->ch && a->bold == b->bold;
+}
+
+
+static void emit_cell(int y, int x) {
+  size_t i = (size_t)y * (size_t)ansi.cols + (size_t)x;
+  const AnsiCell *c = &ansi.back[i];
+  if (c->bold != ansi.cur_bold) {
+    out_str(c->bold ? "\x1b[1m" : "\x1b[22m");
+    ansi.cur_bold = c->bold;
+  }
+  if (c->ch >= ANSI_BRAILLE) {
+    char utf8[3];
+    utf8[0] = (char)(0xE0 | (c->ch >> 12));
+    utf8[1] = (char)(0x80 | ((c->ch >> 6) & 0x3F));
+    utf8[2] = (char)(0x80 | (c->ch & 0x3F));
+    out_bytes(utf8, 3);
+  } else if (c->ch >= ANSI_GLYPH) {
+    out_str(GLYPHS[c->ch - ANSI_GLYPH]);
+  } else {
+    char ch = (char)c->ch;
+    out_bytes(&ch, 1);
+  }
+  ansi.front[i] = *c;
+  ansi.cur_x = x + 1 < ansi.cols ? x + 1 : -1;
+}
+
+
+static void emit_move(int y, int x) {
+  if (ansi.cur_y == y && ansi.cur_x == x) return;
+  if (ansi.cur_y == y && ansi.cur_x >= 0 && x > ansi.cur_x) {
+    int gap = x - ansi.cur_x;
+    int plain = gap <= ANSI_SKIP_MAX;
+    for (int i = ansi.cur_x; plain && i < x; ++i) {
+      const AnsiCell *c = &ansi.back[(size_t)y * (size_t)ansi.cols + (size_t)i];
+      plain = c->ch < ANSI_GLYPH && c->bold == ansi.cur_bold;
+    }
+    if (plain) {
+      for (int i = ansi.cur_x; i < x; ++i) emit_cell(y, i);
+    } else {
+      out_csi(gap, -1, 'C');
+    }
+  } else if (ansi.cur_x == x && ansi.cur_y >= 0 && y > ansi.cur_y) {
+    out_csi(y - ansi.cur_y, -1, 'B');
+  } else if (x == 0 && ansi.cur_y >= 0 && y == ansi.cur_y + 1) {
+    out_str("\r\n");
+  } else {
+    out_csi(y + 1, x + 1, 'H');
+  }
+  ansi.cur_y = y;
+  ansi.cur_x = x;
+}
+
+
+static unsigned long long ansi_present(void) {
+  for (int y = 0; y < ansi.rows; ++y) {
+    const AnsiCell *front = ansi.front + (size_t)y * (size_t)ansi.cols;
+    const AnsiCell *back = ansi.back + (size_t)y * (size_t)ansi.cols;
+    int x = 0;
+    while (x < ansi.cols) {
+      if (cell_same(&front[x], &back[x])) {
+        x = x + 1;
+        continue;
+      }
+      int last = x;
+      for (int j = x + 1; j < ansi.cols && j - last <= ANSI_SKIP_MAX; ++j) {
+        if (!cell_same(&front[j], &back[j])) last = j;
+      }
+      emit_move(y, x);
+      for (int j = x; j <= last; ++j) emit_cell(y, j);
+      x = last + 1;
+    }
+  }
+  return (unsigned long long)out_flush();
+}
+
+
+/* wait_ms > 0 lets the rest of an escape sequence that was split across
+ * reads arrive before the caller gives up on it. */
+static int ansi_next_byte(int wait_ms) {
+  if (ansi.in_pos >= ansi.in_len) {
+    if (wait_ms > 0) {
+      struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+      poll(&pfd, 1, wait_ms);
+    }
+    ssize_t n = read(STDIN_FILENO, ansi.in, sizeof(ansi.in));
+    ansi.in_len = n > 0 ? (int)n : 0;
+    ansi.in_pos = 0;
+  }
+  int b = -1;
+  if (ansi.in_pos < ansi.in_len) b = ansi.in[ansi.in_pos++];
+  return b;
+}
+
+
+static int ansi_arrow(int code) {
+  int key = TERM_KEY_NONE;
+  if (code == 'A')
+    key = TERM_KEY_UP;
+  else if (code == 'B')
+    key = TERM_KEY_DOWN;
+  else if (code == 'C')
+    key = TERM_KEY_RIGHT;
+  else if (code == 'D')
+    key = TERM_KEY_LEFT;
+  return key;
+}
+
+
+static int ansi_read_key(void) {
+  if (ansi_resized != 0) {
+    ansi_resized = 0;
+    screen_resize();
+    return TERM_KEY_RESIZE;
+  }
+  int b = ansi_next_byte(0);
+  int key = b < 0 ? TERM_KEY_NONE : b;
+  if (b == '\r') {
+    key = '\n';
+  } else if (b == TERM_KEY_ESC) {
+    int intro = ansi_next_byte(ANSI_ESC_WAIT_MS);
+    if (intro == '[' || intro == 'O') {
+      int code = ansi_next_byte(ANSI_ESC_WAIT_MS);
+      int plain = 1;
+      while (intro == '[' && code >= 0x20 && code <= 0x3F) {
+        plain = 0;
+        code = ansi_next_byte(ANSI_ESC_WAIT_MS);
+      }
+      if (code >= 0 && (code < 0x40 || code > 0x7E)) ansi.in_pos--;
+      key = plain != 0 ? ansi_arrow(code) : TERM_KEY_NONE;
+      /* Home, F-keys, modified arrows and the like are dropped whole. */
+      if (key == TERM_KEY_NONE) key = ansi_read_key();
+    } else if (intro >= 0) {
+      ansi.in_pos--;
+    }
+  }
+  return key;
+}
+
+
+static void ansi_size(int *rows, int *cols) {
+  *rows = ansi.rows;
+  *cols = ansi.cols;
+}
+
+
+const TermBackend *term_ansi_backend(void) {
+  static const TermBackend backend = {.name = "ansi",
+                                      .open = ansi_open,
+                                      .close = ansi_close,
+                                      .clear = ansi_clear,
+                                      .put_text = ansi_put_text,
+                                      .put_glyph = ansi_put_glyph,
+                                      .put_braille = ansi_put_braille,
+                                      .clear_eol = ansi_clear_eol,
+                                      .set_bold = ansi_set_bold,
+                                      .present = ansi_present,
+                                      .read_key = ansi_read_key,
+                                      .size = ansi_size};
+  return &backend;
+}
@@ -0,0 +1,315 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ncurses.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "term.h"
+
+enum { SINK_CHUNK = 1 << 16 };
+
+typedef struct {
+  int read_fd;
+  int out_fd;
+  int forwarding;
+  pthread_t thread;
+  atomic_ullong bytes;
+  unsigned long long taken;
+} OutputSink;
+
+static OutputSink sink = {.read_fd = -1, .out_fd = -1};
+static SCREEN *null_screen = 0;
+static FILE *null_out = 0;
+static FILE *null_in = 0;
+
+
+static void *sink_forward(void *arg) {
+  (void)arg;
+  static char buf[SINK_CHUNK];
+  int running = 1;
+  while (running != 0) {
+    ssize_t n = read(sink.read_fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      running = 0;
+      continue;
+    }
+    atomic_fetch_add_explicit(&sink.bytes, (unsigned long long)n,
+                              memory_order_relaxed);
+    ssize_t off = 0;
+    while (off < n) {
+      ssize_t w = write(sink.out_fd, buf + off, (size_t)(n - off));
+      if (w < 0 && errno == EINTR) continue;
+      if (w <= 0) break;
+      off += w;
+    }
+  }
+  return NULL;
+}
+
+
+/* Only used while the perf overlay is open: fd 1 is swapped for a pipe
+ * whose reader counts and forwards to the saved terminal. */
+static int sink_open_forward(void) {
+  int p[2];
+  if (pipe(p) != 0) return 0;
+  fflush(stdout);
+  sink.out_fd = dup(STDOUT_FILENO);
+  sink.read_fd = p[0];
+  atomic_store(&sink.bytes, 0);
+  sink.taken = 0;
+  if (sink.out_fd < 0 || dup2(p[1], STDOUT_FILENO) < 0 ||
+      pthread_create(&sink.thread, NULL, sink_forward, NULL) != 0) {
+    if (sink.out_fd >= 0) dup2(sink.out_fd, STDOUT_FILENO);
+    close(p[0]);
+    close(p[1]);
+    if (sink.out_fd >= 0) close(sink.out_fd);
+    sink.read_fd = -1;
+    sink.out_fd = -1;
+    return 0;
+  }
+  close(p[1]);
+  sink.forwarding = 1;
+  return 1;
+}
+
+
+static int sink_open_null(void) {
+  int p[2];
+  if (pipe(p) != 0) return -1;
+  fcntl(p[0], F_SETFL, fcntl(p[0], F_GETFL) | O_NONBLOCK);
+  sink.read_fd = p[0];
+  sink.out_fd = -1;
+  atomic_store(&sink.bytes, 0);
+  sink.taken = 0;
+  return p[1];
+}
+
+
+static void sink_close(void) {
+  if (sink.forwarding != 0) {
+    fflush(stdout);
+    dup2(sink.out_fd, STDOUT_FILENO);
+    pthread_join(sink.thread, NULL);
+    sink.forwarding = 0;
+  }
+  if (sink.read_fd >= 0) close(sink.read_fd);
+  if (sink.out_fd >= 0) close(sink.out_fd);
+  sink.read_fd = -1;
+  sink.out_fd = -1;
+}
+
+
+static unsigned long long sink_take(void) {
+  if (sink.forwarding == 0 && sink.read_fd >= 0) {
+    static char buf[SINK_CHUNK];
+    ssize_t n = read(sink.read_fd, buf, sizeof(buf));
+    while (n > 0) {
+      atomic_fetch_add_explicit(&sink.bytes, (unsigned long long)n,
+                                memory_order_relaxed);
+      n = n == (ssize_t)sizeof(buf) ? read(sink.read_fd, buf, sizeof(buf)) : 0;
+    }
+  }
+  unsigned long long now =
+      atomic_load_explicit(&sink.bytes, memory_order_relaxed);
+  unsigned long long bytes = now - sink.taken;
+  sink.taken = now;
+  return bytes;
+}
+
+
+static void nc_setup(void) {
+  cbreak();
+  noecho();
+  keypad(stdscr, TRUE);
+  nodelay(stdscr, TRUE);
+  curs_set(0);
+}
+
+
+static int nc_open(void) {
+  initscr();
+  nc_setup();
+  return 1;
+}
+
+
+static void nc_close(void) {
+  sink_close();
+  endwin();
+}
+
+
+static void nc_close_null(void) {
+  endwin();
+  if (null_screen != 0) delscreen(null_screen);
+  if (null_out != 0) fclose(null_out);
+  if (null_in != 0) fclose(null_in);
+  null_screen = 0;
+  null_out = 0;
+  null_in = 0;
+  sink_close();
+}
+
+
+static int nc_open_null(void) {
+  const char *type = getenv("TERM");
+  if (type == 0 || type[0] == 0 || strcmp(type, "dumb") == 0) type = "xterm";
+  int out_fd = sink_open_null();
+  null_out = out_fd >= 0 ? fdopen(out_fd, "w") : 0;
+  null_in = fopen("/dev/null", "r");
+  if (null_out == 0 && out_fd >= 0) close(out_fd);
+  if (null_out != 0 && null_in != 0) {
+    null_screen = newterm(type, null_out, null_in);
+  }
+  if (null_screen == 0) {
+    nc_close_null();
+    return 0;
+  }
+  set_term(null_screen);
+  nc_setup();
+  return 1;
+}
+
+
+static void nc_clear(void) { clear(); }
+
+
+static void nc_put_text(int y, int x, const char *s) { mvaddstr(y, x, s); }
+
+
+static void nc_put_glyph(int y, int x, TermGlyph g) {
+  chtype ch = ACS_HLINE;
+  if (g == TERM_GLYPH_ULCORNER)
+    ch = ACS_ULCORNER;
+  else if (g == TERM_GLYPH_URCORNER)
+    ch = ACS_URCORNER;
+  else if (g == TERM_GLYPH_LLCORNER)
+    ch = ACS_LLCORNER;
+  else if (g == TERM_GLYPH_LRCORNER)
+    ch = ACS_LRCORNER;
+  else if (g == TERM_GLYPH_VLINE)
+    ch = ACS_VLINE;
+  mvaddch(y, x, ch);
+}
+
+
+static void nc_put_braille(int y, int x, unsigned dots) {
+  int n = __builtin_popcount(dots & 0xFFu);
+  char ch = ' ';
+  if (n >= 6)
+    ch = '#';
+  else if (n >= 3)
+    ch = ':';
+  else if (n >= 1)
+    ch = '.';
+  mvaddch(y, x, (chtype)ch);
+}
+
+
+static void nc_clear_eol(int y, int x) {
+  move(y, x);
+  clrtoeol();
+}
+
+
+static void nc_set_bold(int on) {
+  if (on != 0)
+    attron(A_BOLD);
+  else
+    attroff(A_BOLD);
+}
+
+
+static unsigned long long nc_present(void) {
+  refresh();
+  return sink_take();
+}
+
+
+static void nc_count_output(int on) {
+  if (on != 0 && sink.read_fd < 0) {
+    sink_open_forward();
+  } else if (on == 0 && sink.forwarding != 0) {
+    sink_close();
+  }
+}
+
+
+static void nc_resize_forwarded(void) {
+  struct winsize ws;
+  if (ioctl(sink.out_fd, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 &&
+      ws.ws_col > 0) {
+    resize_term(ws.ws_row, ws.ws_col);
+  }
+}
+
+
+static int nc_read_key(void) {
+  int ch = getch();
+  if (ch == KEY_RESIZE && sink.forwarding != 0) nc_resize_forwarded();
+  int key = ch;
+  if (ch == ERR)
+    key = TERM_KEY_NONE;
+  else if (ch == KEY_LEFT)
+    key = TERM_KEY_LEFT;
+  else if (ch == KEY_RIGHT)
+    key = TERM_KEY_RIGHT;
+  else if (ch == KEY_UP)
+    key = TERM_KEY_UP;
+  else if (ch == KEY_DOWN)
+    key = TERM_KEY_DOWN;
+  else if (ch == KEY_RESIZE)
+    key = TERM_KEY_RESIZE;
+  return key;
+}
+
+
+static void nc_size(int *rows, int *cols) {
+  int r = 0, c = 0;
+  getmaxyx(stdscr, r, c);
+  *rows = r;
+  *cols = c;
+}
+
+
+const TermBackend *term_ncurses_backend(void) {
+  static const TermBackend backend = {.name = "ncurses",
+                                      .open = nc_open,
+                                      .close = nc_close,
+                                      .clear = nc_clear,
+                                      .put_text = nc_put_text,
+                                      .put_glyph = nc_put_glyph,
+                                      .put_braille = nc_put_braille,
+                                      .clear_eol = nc_clear_eol,
+                                      .set_bold = nc_set_bold,
+                                      .present = nc_present,
+                                      .count_output = nc_count_output,
+                                      .read_key = nc_read_key,
+                                      .size = nc_size};
+  return &backend;
+}
+
+
+const TermBackend *term_ncurses_null_backend(void) {
+  static const TermBackend backend = {.name = "ncurses-null",
+                                      .open = nc_open_null,
+                                      .close = nc_close_null,
+                                      .clear = nc_clear,
+                                      .put_text = nc_put_text,
+                                      .put_glyph = nc_put_glyph,
+                                      .put_braille = nc_put_braille,
+                                      .clear_eol = nc_clear_eol,
+                                      .set_bold = nc_set_bold,
+                                      .present = nc_present,
+                                      .read_key = nc_read_key,
+                                      .size = nc_size};
+  return &backend;
+}
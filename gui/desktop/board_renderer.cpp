@@ -0,0 +1,171 @@
+#include "board_renderer.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+static const QRgb kBoardBack = qRgb(18, 18, 18);
+static const QRgb kCellOff = qRgb(30, 30, 30);
+static const QRgb kCellEdge = qRgb(45, 45, 45);
+static const QRgb kCellOn = qRgb(0x4C, 0xAF, 0x50);
+
+
+BoardRenderer::BoardRenderer(QObject* parent) : QObject(parent) {
+  qRegisterMetaType<BoardRaster>();
+}
+
+
+void BoardRenderer::submit(BoardJob job) {
+  QMutexLocker lock(&mutex_);
+  pending_ = std::move(job);
+  has_pending_ = true;
+  if (!scheduled_) {
+    scheduled_ = true;
+    QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+  }
+}
+
+
+void BoardRenderer::drain() {
+  BoardJob job;
+  {
+    QMutexLocker lock(&mutex_);
+    scheduled_ = false;
+    if (!has_pending_) return;
+    job = std::move(pending_);
+    has_pending_ = false;
+  }
+  BoardRaster raster;
+  render(job, raster);
+  emit rendered(raster);
+}
+
+
+bool BoardRenderer::geometryChanged(const BoardJob& job) const {
+  return board_.isNull() || job.rows != shape_.rows ||
+         job.cols != shape_.cols || job.board_size != shape_.board_size ||
+         job.grid_origin != shape_.grid_origin || job.cell != shape_.cell ||
+         job.next_cell != shape_.next_cell || job.dpr != shape_.dpr;
+}
+
+
+void BoardRenderer::paintCell(QImage& img, int x, int y, int size,
+                              bool on) const {
+  const int inset = std::min(inset_px_, (size - 1) / 2);
+  const int x0 = std::max(0, x + inset);
+  const int x1 = std::min(img.width(), x + size - inset);
+  const int y0 = std::max(0, y + inset);
+  const int y1 = std::min(img.height(), y + size - inset);
+  if (x0 >= x1 || y0 >= y1) return;
+  for (int py = y0; py < y1; ++py) {
+    QRgb* line = reinterpret_cast<QRgb*>(img.scanLine(py));
+    if (on) {
+      std::fill(line + x0, line + x1, kCellOn);
+    } else if (py == y0 || py == y1 - 1) {
+      std::fill(line + x0, line + x1, kCellEdge);
+    } else {
+      line[x0] = kCellEdge;
+      std::fill(line + x0 + 1, line + x1 - 1, kCellOff);
+      line[x1 - 1] = kCellEdge;
+    }
+  }
+}
+
+
+void BoardRenderer::rebuildGrid(const BoardJob& job) {
+  shape_.rows = job.rows;
+  shape_.cols = job.cols;
+  shape_.board_size = job.board_size;
+  shape_.grid_origin = job.grid_origin;
+  shape_.cell = job.cell;
+  shape_.next_cell = job.next_cell;
+  shape_.dpr = job.dpr;
+
+  const QSize px = (job.board_size.expandedTo(QSize(1, 1)) * job.dpr);
+  cell_px_ = std::max(1, qRound(job.cell * job.dpr));
+  inset_px_ = std::max(1, qRound(job.dpr));
+  origin_px_ = QPoint(qRound(job.grid_origin.x() * job.dpr),
+                      qRound(job.grid_origin.y() * job.dpr));
+
+  grid_ = QImage(px, QImage::Format_ARGB32_Premultiplied);
+  grid_.setDevicePixelRatio(job.dpr);
+  grid_.fill(kBoardBack);
+  for (int r = 0; r < job.rows; ++r) {
+    for (int c = 0; c < job.cols; ++c) {
+      paintCell(grid_, origin_px_.x() + c * cell_px_,
+                origin_px_.y() + r * cell_px_, cell_px_, false);
+    }
+  }
+  board_ = grid_.copy();
+  board_.setDevicePixelRatio(job.dpr);
+  shown_.assign(static_cast<size_t>(job.rows) * job.cols, 0);
+  next_valid_ = false;
+}
+
+
+void BoardRenderer::paintNext(const BoardJob& job, BoardRaster& out) {
+  if (next_valid_ && std::memcmp(shown_next_, job.next, sizeof(job.next)) == 0)
+    return;
+  std::memcpy(shown_next_, job.next, sizeof(job.next));
+  next_valid_ = true;
+
+  const int cell = std::max(1, qRound(job.next_cell * job.dpr));
+  QImage next(cell * 4, cell * 4, QImage::Format_ARGB32_Premultiplied);
+  next.setDevicePixelRatio(job.dpr);
+  next.fill(kBoardBack);
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      paintCell(next, c * cell, r * cell, cell, job.next[r * 4 + c] != 0);
+    }
+  }
+  out.next = next;
+  out.next_changed = true;
+}
+
+
+void BoardRenderer::render(const BoardJob& job, BoardRaster& out) {
+  out.seq = job.seq;
+  out.motion = job.motion;
+  if (geometryChanged(job)) {
+    rebuildGrid(job);
+    out.grid = grid_;
+    out.full = true;
+  }
+
+  if (!job.cells.empty()) {
+    for (int r = 0; r < job.rows; ++r) {
+      const int* row = job.cells.data() + static_cast<size_t>(r) * job.cols;
+      int* shown = shown_.data() + static_cast<size_t>(r) * job.cols;
+      int first = -1, last = -1;
+      for (int c = 0; c < job.cols; ++c) {
+        const int v = row[c] != 0;
+        if (shown[c] == v) continue;
+        shown[c] = v;
+        paintCell(board_, origin_px_.x() + c * cell_px_,
+                  origin_px_.y() + r * cell_px_, cell_px_, v != 0);
+        if (first < 0) first = c;
+        last = c;
+      }
+      if (first >= 0 && !out.full) {
+        out.dirty.push_back(QRect(job.grid_origin.x() + first * job.cell,
+                                  job.grid_origin.y() + r * job.cell,
+                                  (last - first + 1) * job.cell, job.cell));
+        const QRect px = QRect(origin_px_.x() + first * cell_px_,
+                               origin_px_.y() + r * cell_px_,
+                               (last - first + 1) * cell_px_, cell_px_) &
+                         board_.rect();
+        if (!px.isEmpty()) {
+          out.patches.push_back({px.topLeft(), board_.copy(px)});
+        }
+      }
+    }
+  }
+
+  paintNext(job, out);
+  if (out.full) {
+    out.board = board_.copy();
+    out.board.setDevicePixelRatio(job.dpr);
+  }
+}
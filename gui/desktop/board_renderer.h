@@ -0,0 +1,100 @@
+#ifndef BOARD_RENDERER_H
+#define BOARD_RENDERER_H
+
+#include <QImage>
+#include <QMetaType>
+#include <QMutex>
+#include <QObject>
+#include <QRect>
+#include <QVector>
+
+#include <vector>
+
+#include "brick_game_api.h"
+
+
+struct BoardJob {
+  unsigned long long seq = 0;
+  int rows = 0;
+  int cols = 0;
+  std::vector<int> cells;
+  int next[16] = {};
+  MotionHint_t motion = {};
+
+  QSize board_size;
+  QPoint grid_origin;
+  int cell = 1;
+  int next_cell = 1;
+  qreal dpr = 1.0;
+};
+
+
+struct BoardPatch {
+  QPoint at;
+  QImage image;
+};
+
+
+struct BoardRaster {
+  unsigned long long seq = 0;
+  QImage board;
+  QImage grid;
+  QImage next;
+  QVector<QRect> dirty;
+  QVector<BoardPatch> patches;
+  bool full = false;
+  bool next_changed = false;
+  MotionHint_t motion = {};
+};
+
+Q_DECLARE_METATYPE(BoardRaster)
+
+
+class BoardRenderer : public QObject {
+  Q_OBJECT
+ public:
+
+  explicit BoardRenderer(QObject* parent = nullptr);
+
+
+  void submit(BoardJob job);
+
+ signals:
+
+  void rendered(const BoardRaster& raster);
+
+ private slots:
+
+  void drain();
+
+ private:
+
+  void render(const BoardJob& job, BoardRaster& out);
+
+  bool geometryChanged(const BoardJob& job) const;
+
+  void rebuildGrid(const BoardJob& job);
+
+  void paintCell(QImage& img, int x, int y, int size, bool on) const;
+
+  void paintNext(const BoardJob& job, BoardRaster& out);
+
+
+  QMutex mutex_;
+  BoardJob pending_;
+  bool has_pending_ = false;
+  bool scheduled_ = false;
+
+
+  BoardJob shape_;
+  QImage grid_;
+  QImage board_;
+  std::vector<int> shown_;
+  int shown_next_[16] = {};
+  bool next_valid_ = false;
+  int cell_px_ = 1;
+  int inset_px_ = 1;
+  QPoint origin_px_;
+};
+
+#endif
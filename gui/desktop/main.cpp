@@ -1,11 +1,47 @@
 #include <QApplication>
+#include <QScrollArea>
 
+#include "multi_view.h"
+#include "trace.h"
 #include "view.h"
 
 int main(int argc, char* argv[]) {
   QApplication app(argc, argv);
+  const QStringList args = app.arguments();
+  const int trace_at = args.indexOf(QStringLiteral("--trace"));
+  if (trace_at >= 0 && args.size() > trace_at + 1) {
+    trace_start(args.at(trace_at + 1).toLocal8Bit().constData());
+    trace_thread_name("gui");
+  }
+
+  const int multi = args.indexOf(QStringLiteral("--multi"));
+  if (multi >= 0) {
+    const int count = args.value(multi + 1).toInt();
+    const int fps_at = args.indexOf(QStringLiteral("--fps"));
+    const int fps = fps_at >= 0 ? args.value(fps_at + 1).toInt() : 30;
+    QScrollArea area;
+    area.setWidgetResizable(true);
+    area.setWidget(new MultiView(count > 0 ? count : 64, fps > 0 ? fps : 30));
+    area.setWindowTitle("BrickGame");
+    area.resize(1024, 768);
+    area.show();
+    const int rc = app.exec();
+    trace_stop();
+    return rc;
+  }
+
+  const bool latency = args.contains(QStringLiteral("--latency"));
+  if (latency) latency_watch_signal();
+
   View w;
   w.setWindowTitle("BrickGame");
   w.show();
-  return app.exec();
-}
\ No newline at end of file
+  const int rc = app.exec();
+  if (latency) latency_print(&w.inputLatency(), "input-latency", stderr);
+  const int stats_at = args.indexOf(QStringLiteral("--fsm-stats"));
+  if (stats_at >= 0 && args.size() > stats_at + 1) {
+    dumpFsmStats(args.at(stats_at + 1).toLocal8Bit().constData());
+  }
+  trace_stop();
+  return rc;
+}
@@ -0,0 +1,181 @@
+#include "multi_view.h"
+
+#include <QPaintEvent>
+#include <QPainter>
+
+#include <algorithm>
+
+static const QRgb kTileOn = qRgb(0x4C, 0xAF, 0x50);
+static const QRgb kTileOff = qRgb(30, 30, 30);
+static const int kMinTileWidth = 16;
+
+
+MultiView::MultiView(int count, int fps, QWidget* parent) : QWidget(parent) {
+  setMinimumSize(320, 240);
+  setAttribute(Qt::WA_OpaquePaintEvent);
+
+  tiles_.resize(static_cast<size_t>(std::max(1, count)));
+  for (size_t i = 0; i < tiles_.size(); ++i) {
+    autoplay_open(&tiles_[i].player, static_cast<int>(i));
+  }
+  gameSelect(tiles_.front().player.game);
+  getFieldSize(&rows_, &cols_);
+  gameSelect(nullptr);
+
+  timer_.setTimerType(Qt::PreciseTimer);
+  connect(&timer_, &QTimer::timeout, this, &MultiView::onTick);
+  setRefreshRate(fps);
+  timer_.start();
+}
+
+
+MultiView::~MultiView() {
+  timer_.stop();
+  gameSelect(nullptr);
+  for (Tile& tile : tiles_) autoplay_close(&tile.player);
+}
+
+
+void MultiView::setRefreshRate(int fps) {
+  timer_.setInterval(std::max(1, 1000 / std::max(1, fps)));
+}
+
+
+void MultiView::resizeEvent(QResizeEvent* event) {
+  QWidget::resizeEvent(event);
+  relayout();
+}
+
+
+void MultiView::relayout() {
+  const int n = static_cast<int>(tiles_.size());
+  const int w = width();
+  const int h = height();
+  int best_cols = 1;
+  int best_w = 0;
+  for (int c = 1; c <= n; ++c) {
+    const int lines = (n + c - 1) / c;
+    const int by_w = (w - gap_) / c - gap_;
+    const int by_h = ((h - gap_) / lines - gap_) * cols_ / std::max(1, rows_);
+    const int tw = std::min(by_w, by_h);
+    if (tw > best_w) {
+      best_w = tw;
+      best_cols = c;
+    }
+  }
+  if (best_w < kMinTileWidth) {
+    best_w = kMinTileWidth;
+    best_cols = std::max(1, (w - gap_) / (best_w + gap_));
+  }
+  columns_ = best_cols;
+  tile_size_ = QSize(best_w, std::max(1, best_w * rows_ / std::max(1, cols_)));
+
+  const int lines = (n + columns_ - 1) / columns_;
+  const int need = gap_ + lines * (tile_size_.height() + gap_);
+  if (need > h && minimumHeight() != need) setMinimumHeight(need);
+  for (Tile& tile : tiles_) tile.dirty = true;
+  update();
+}
+
+
+QRect MultiView::tileRect(int index) const {
+  const int col = index % columns_;
+  const int line = index / columns_;
+  return QRect(gap_ + col * (tile_size_.width() + gap_),
+               gap_ + line * (tile_size_.height() + gap_), tile_size_.width(),
+               tile_size_.height());
+}
+
+
+void MultiView::stepTile(Tile& tile) {
+  GameInfo_t g = updateCurrentState();
+  const size_t count = static_cast<size_t>(rows_) * cols_;
+  if (tile.cells.size() != count) {
+    tile.cells.assign(count, 0);
+    tile.dirty = true;
+  }
+  if (g.field) {
+    for (int r = 0; r < rows_; ++r) {
+      int* shown = tile.cells.data() + static_cast<size_t>(r) * cols_;
+      for (int c = 0; c < cols_; ++c) {
+        const int v = g.field[r][c] != 0;
+        if (shown[c] == v) continue;
+        shown[c] = v;
+        tile.dirty = true;
+      }
+    }
+  }
+  if (tile.score != g.score) {
+    tile.score = g.score;
+    tile.dirty = true;
+  }
+  freeGameInfo(&g);
+  autoplay_restart_if_over(&tile.player);
+}
+
+
+void MultiView::rasterTile(Tile& tile, const QSize& target) {
+  const int f = std::max({1, (cols_ + target.width() - 1) / target.width(),
+                          (rows_ + target.height() - 1) / target.height()});
+  const int iw = (cols_ + f - 1) / f;
+  const int ih = (rows_ + f - 1) / f;
+  if (tile.image.width() != iw || tile.image.height() != ih) {
+    tile.image = QImage(iw, ih, QImage::Format_RGB32);
+  }
+  if (tile.cells.empty()) {
+    tile.image.fill(kTileOff);
+    return;
+  }
+  for (int y = 0; y < ih; ++y) {
+    QRgb* line = reinterpret_cast<QRgb*>(tile.image.scanLine(y));
+    const int r1 = std::min(rows_, (y + 1) * f);
+    for (int x = 0; x < iw; ++x) {
+      const int c1 = std::min(cols_, (x + 1) * f);
+      bool on = false;
+      for (int r = y * f; r < r1 && !on; ++r) {
+        const int* row = tile.cells.data() + static_cast<size_t>(r) * cols_;
+        for (int c = x * f; c < c1 && !on; ++c) on = row[c] != 0;
+      }
+      line[x] = on ? kTileOn : kTileOff;
+    }
+  }
+}
+
+
+void MultiView::onTick() {
+  const QRect visible = visibleRegion().boundingRect();
+  for (size_t i = 0; i < tiles_.size(); ++i) {
+    Tile& tile = tiles_[i];
+    gameSelect(tile.player.game);
+    if (autoplay_) autoplay_drive(&tile.player);
+    stepTile(tile);
+    if (!tile.dirty) continue;
+    const QRect rc = tileRect(static_cast<int>(i));
+    if (visible.intersects(rc)) update(rc);
+  }
+  gameSelect(nullptr);
+}
+
+
+void MultiView::paintEvent(QPaintEvent* event) {
+  QPainter p(this);
+  p.setRenderHint(QPainter::SmoothPixmapTransform, false);
+  p.fillRect(event->rect(), QColor(10, 10, 10));
+
+  const bool labels = tile_size_.height() >= 48;
+  if (labels) p.setPen(QColor(200, 200, 200));
+  for (size_t i = 0; i < tiles_.size(); ++i) {
+    const QRect rc = tileRect(static_cast<int>(i));
+    if (!event->region().intersects(rc)) continue;
+    Tile& tile = tiles_[i];
+    if (tile.dirty || tile.image.isNull()) {
+      rasterTile(tile, tile_size_);
+      tile.dirty = false;
+    }
+    p.drawImage(rc, tile.image);
+    if (labels) {
+      p.drawText(rc.adjusted(3, 2, -3, -2), Qt::AlignTop | Qt::AlignLeft,
+                 QString::number(tile.score));
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef MULTI_VIEW_H
+#define MULTI_VIEW_H
+
+#include <QImage>
+#include <QTimer>
+#include <QWidget>
+
+#include <vector>
+
+#include "autoplay.h"
+#include "brick_game_api.h"
+
+
+class MultiView : public QWidget {
+  Q_OBJECT
+ public:
+
+  explicit MultiView(int count, int fps = 30, QWidget* parent = nullptr);
+
+  ~MultiView() override;
+
+
+  void setRefreshRate(int fps);
+
+  void setAutoplay(bool on) { autoplay_ = on; }
+
+  int tileCount() const { return static_cast<int>(tiles_.size()); }
+
+ protected:
+
+  void paintEvent(QPaintEvent* event) override;
+
+  void resizeEvent(QResizeEvent* event) override;
+
+ private slots:
+
+  void onTick();
+
+ private:
+
+  struct Tile {
+    AutoPlayer player = {};
+    std::vector<int> cells;
+    QImage image;
+    int score = 0;
+    bool dirty = true;
+  };
+
+
+  void relayout();
+
+  QRect tileRect(int index) const;
+
+  void stepTile(Tile& tile);
+
+  void rasterTile(Tile& tile, const QSize& target);
+
+
+  std::vector<Tile> tiles_;
+  int rows_ = 20;
+  int cols_ = 10;
+  int columns_ = 1;
+  QSize tile_size_;
+  int gap_ = 2;
+  bool autoplay_ = true;
+  QTimer timer_;
+};
+
+#endif
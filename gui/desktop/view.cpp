@@ -1,116 +1,321 @@
 #include "view.h"
 
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QKeyEvent>
 #include <QPainter>
-#include <QTimer>
+#include <QScreen>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
-void View::paintEvent(QPaintEvent*) {
-  QPainter p(this);
-  p.setRenderHint(QPainter::Antialiasing, false);
+#include "alloc_track.h"
+#include "bg_clock.h"
+#include "trace.h"
 
-  const QRect bounds =
-      rect().adjusted(margin_out_, margin_out_, -margin_out_, -margin_out_);
-  drawBorder(p, bounds);
+static const QRgb kCellOn = qRgb(0x4C, 0xAF, 0x50);
 
-  GameInfo_t g = updateCurrentState();
 
-  const int hudWidth = qMax(120, bounds.width() / 3);
-  const QRect boardArea =
-      QRect(bounds.left() + margin_in_, bounds.top() + margin_in_,
-            bounds.width() - hudWidth - 2 * margin_in_,
-            bounds.height() - 2 * margin_in_);
-  const QRect hudArea =
-      QRect(boardArea.right() + margin_in_, bounds.top() + margin_in_,
-            hudWidth - 2 * margin_in_, bounds.height() - 2 * margin_in_);
+void View::paintEvent(QPaintEvent* event) {
+  trace_begin("View::paintEvent");
+  QElapsedTimer clock;
+  clock.start();
+  AllocScope allocs;
+  alloc_scope_begin(&allocs);
 
-  int rows = rows_, cols = cols_;
+  QPainter p(this);
+  p.setRenderHint(QPainter::Antialiasing, false);
+  const QRegion& dirty = event->region();
 
-  if (g.field) {
-    drawMatrix(p, g.field, rows, cols, boardArea);
-  } else {
-    p.fillRect(boardArea, QColor(18, 18, 18));
+  if (!layout_.board.contains(event->rect())) {
+    drawBorder(p, layout_.bounds);
   }
 
-  const bool game_over = isGameOver();
-  drawHUD(p, hudArea, g, game_over);
+  const SimFrame* frame = frame_;
+  GameInfo_t g = sim_frame_info(frame);
 
-  if (g.next) {
-    p.save();
-    p.setPen(QColor(200, 200, 200));
-    QFont f = p.font();
-    f.setBold(true);
-    p.setFont(f);
-    const int pad = 8;
-    const int availW = hudArea.width() - 2 * pad;
-    const int availH = hudArea.height() - 2 * pad;
+  if (dirty.intersects(layout_.board)) {
+    if (!board_image_.isNull()) {
+      p.drawImage(layout_.board.topLeft(), board_image_);
+      if (shown_motion_.count > 0 && !grid_image_.isNull()) {
+        drawMotion(p, shown_motion_);
+      }
+    } else {
+      p.fillRect(layout_.board, QColor(18, 18, 18));
+    }
+  }
 
-    const int boardCellW = qMax(1, boardArea.width() / qMax(1, cols));
-    const int boardCellH = qMax(1, boardArea.height() / qMax(1, rows));
-    const int boardCell = qMin(boardCellW, boardCellH);
+  if (dirty.intersects(layout_.hud)) {
+    const bool game_over = frame && frame->game_over;
+    drawHUD(p, layout_.hud, g, game_over);
+  }
 
-    int pvCell = boardCell;
-    pvCell = qMin(pvCell, availW / 4);
-    pvCell = qMin(pvCell, availH / 4);
-    if (pvCell < 1) pvCell = 1;
+  if (quit_pending_) {
+  }
 
-    const int size = pvCell * 4;
-    const int nx = hudArea.left() + (hudArea.width() - size) / 2;
-    const int ny = hudArea.top() + (hudArea.height() - size) / 2;
-    const QRect nextArea(nx, ny, size, size);
-    p.drawText(QRect(hudArea.left(), ny - 18, hudArea.width(), 16),
-               Qt::AlignHCenter, "NEXT");
-    drawMatrix(p, g.next, 4, 4, nextArea);
-    p.restore();
+  alloc_scope_end(&allocs);
+  paint_allocs_last_ = allocs.count;
+  paint_alloc_bytes_last_ = allocs.bytes;
+  paint_ns_last_ = clock.nsecsElapsed();
+  paint_ns_total_ += paint_ns_last_;
+  paint_count_ += 1;
+  if (perf_visible_ &&
+      perf_meter_frame(&perf_, paint_ns_last_, 0, hud_values_[3])) {
+    syncPerfText();
+    update(layout_.hud);
+  }
+  if (latency_pending_ns_ != 0 && rendered_seq_ >= latency_seq_) {
+    latency_record(&input_latency_, bg_clock_now_ns() - latency_pending_ns_);
+    latency_pending_ns_ = 0;
   }
+  trace_end("View::paintEvent");
+}
 
-  freeGameInfo(&g);
 
-  if (quit_pending_) {
+double View::motionProgress(const MotionHint_t& m) const {
+  if (m.interval_ms <= 0.0) return 0.0;
+  const double since = (bg_clock_now_ns() - m.clock_ns) / 1e6;
+  return qBound(0.0, m.progress + since / m.interval_ms, 1.0);
+}
+
+
+QRect View::motionRect(const MotionHint_t& m) const {
+  QRect area;
+  for (int i = 0; i < m.count; ++i) {
+    const MotionCell_t& c = m.cells[i];
+    area |= cellRect(c.row, c.col) | cellRect(c.row + c.dr, c.col + c.dc);
   }
+  return area & layout_.grid;
 }
 
 
-void View::drawBorder(QPainter& p, const QRect& r) {
+void View::drawMotion(QPainter& p, const MotionHint_t& m) {
+  const double t = motionProgress(m);
+  const qreal dpr = grid_image_.devicePixelRatio();
+  const QPoint origin = layout_.board.topLeft();
+  const QColor on(kCellOn);
+
+  for (int i = 0; i < m.count; ++i) {
+    const MotionCell_t& c = m.cells[i];
+    if (c.kind == MotionGrow) continue;
+    const QRect rc = cellRect(c.row, c.col);
+    const QRect src = rc.translated(-origin);
+    p.drawImage(QRectF(rc), grid_image_,
+                QRectF(src.x() * dpr, src.y() * dpr, src.width() * dpr,
+                       src.height() * dpr));
+  }
+
   p.save();
-  p.setPen(QPen(QColor(90, 90, 90), 2));
-  p.drawRect(r.adjusted(0, 0, -1, -1));
+  p.setClipRect(layout_.grid);
+  for (int i = 0; i < m.count; ++i) {
+    const MotionCell_t& c = m.cells[i];
+    const QRectF body = QRectF(cellRect(c.row, c.col)).adjusted(1, 1, -1, -1);
+    const QPointF shift(c.dc * t * layout_.cell, c.dr * t * layout_.cell);
+    if (c.kind == MotionGrow) {
+      p.fillRect(body.united(body.translated(shift)), on);
+    } else {
+      p.fillRect(body.translated(shift), on);
+    }
+  }
   p.restore();
 }
 
 
-void View::drawMatrix(QPainter& p, int** grid, int rows, int cols,
-                      const QRect& area) {
-  p.save();
-  p.fillRect(area, QColor(18, 18, 18));
+void View::onAnimate() {
+  if (shown_motion_.count == 0) {
+    anim_timer_->stop();
+    return;
+  }
+  const int budget = anim_interval_ms_;
+  const int needed = static_cast<int>(std::ceil(2.0 * lastPaintMs()));
+  anim_timer_->setInterval(qMax(budget, needed));
+  update(motion_rect_);
+}
+
 
-  if (rows <= 0 || cols <= 0) {
-    p.restore();
+void View::syncAnimation() {
+  if (!motion_rect_.isEmpty()) update(motion_rect_);
+  const bool moving = shown_motion_.count > 0 && frame_ && !frame_->pause &&
+                      !frame_->game_over;
+  motion_rect_ = moving ? motionRect(shown_motion_) : QRect();
+  if (!moving) {
+    anim_timer_->stop();
     return;
   }
+  const qreal hz = screen() ? screen()->refreshRate() : 60.0;
+  anim_interval_ms_ = qMax(1, qRound(1000.0 / qMax<qreal>(hz, 1.0)));
+  if (!anim_timer_->isActive()) anim_timer_->start(anim_interval_ms_);
+}
 
-  const int cellW = qMax(1, area.width() / cols);
-  const int cellH = qMax(1, area.height() / rows);
-  const int cell = qMin(cellW, cellH);
 
-  const int offsetX = area.left() + (area.width() - cell * cols) / 2;
-  const int offsetY = area.top() + (area.height() - cell * rows) / 2;
+void View::resizeEvent(QResizeEvent* event) {
+  QWidget::resizeEvent(event);
+  relayout();
+}
 
-  for (int r = 0; r < rows; ++r) {
-    for (int c = 0; c < cols; ++c) {
-      const int v = grid[r][c];
-      QRect rc(offsetX + c * cell, offsetY + r * cell, cell, cell);
-      if (v) {
-        p.fillRect(rc.adjusted(1, 1, -1, -1), QColor(0x4C, 0xAF, 0x50));
-      } else {
-        p.fillRect(rc.adjusted(1, 1, -1, -1), QColor(30, 30, 30));
-        p.setPen(QColor(45, 45, 45));
-        p.drawRect(rc.adjusted(1, 1, -2, -2));
-      }
+
+void View::computeLayout() {
+  Layout& l = layout_;
+  l.bounds =
+      rect().adjusted(margin_out_, margin_out_, -margin_out_, -margin_out_);
+  const int hudWidth = qMax(120, l.bounds.width() / 3);
+  l.board = QRect(l.bounds.left() + margin_in_, l.bounds.top() + margin_in_,
+                  l.bounds.width() - hudWidth - 2 * margin_in_,
+                  l.bounds.height() - 2 * margin_in_);
+  l.hud = QRect(l.board.right() + margin_in_, l.bounds.top() + margin_in_,
+                hudWidth - 2 * margin_in_, l.bounds.height() - 2 * margin_in_);
+
+  const int cellW = qMax(1, l.board.width() / qMax(1, cols_));
+  const int cellH = qMax(1, l.board.height() / qMax(1, rows_));
+  l.cell = qMin(cellW, cellH);
+  l.grid = QRect(l.board.left() + (l.board.width() - l.cell * cols_) / 2,
+                 l.board.top() + (l.board.height() - l.cell * rows_) / 2,
+                 l.cell * cols_, l.cell * rows_);
+
+  const int pad = 8;
+  int pvCell = l.cell;
+  pvCell = qMin(pvCell, (l.hud.width() - 2 * pad) / 4);
+  pvCell = qMin(pvCell, (l.hud.height() - 2 * pad) / 4);
+  l.next_cell = qMax(1, pvCell);
+  const int size = l.next_cell * 4;
+  l.next = QRect(l.hud.left() + (l.hud.width() - size) / 2,
+                 l.hud.top() + (l.hud.height() - size) / 2, size, size);
+}
+
+
+void View::relayout() {
+  computeLayout();
+  syncHud(frame_, true);
+  submitFrame(frame_);
+  update();
+}
+
+
+void View::submitFrame(const SimFrame* frame) {
+  if (!renderer_) return;
+  BoardJob job;
+  job.seq = frame ? frame->seq : 0;
+  job.rows = rows_;
+  job.cols = cols_;
+  if (frame && frame->cells && frame->rows == rows_ && frame->cols == cols_) {
+    job.cells.assign(frame->cells,
+                     frame->cells + static_cast<size_t>(rows_) * cols_);
+    std::memcpy(job.next, frame->next_cells, sizeof(job.next));
+    job.motion = frame->motion;
+  }
+  job.board_size = layout_.board.size();
+  job.grid_origin = layout_.grid.topLeft() - layout_.board.topLeft();
+  job.cell = layout_.cell;
+  job.next_cell = layout_.next_cell;
+  job.dpr = devicePixelRatioF();
+  renderer_->submit(std::move(job));
+}
+
+
+void View::onRendered(const BoardRaster& raster) {
+  rendered_seq_ = raster.seq;
+  if (!raster.board.isNull()) board_image_ = raster.board;
+  for (const BoardPatch& patch : raster.patches) blitPatch(patch);
+  if (!raster.grid.isNull()) grid_image_ = raster.grid;
+  if (raster.next_changed) {
+    next_image_ = raster.next;
+    update(layout_.next);
+  }
+  if (raster.full) {
+    update(layout_.board);
+  } else {
+    for (const QRect& rc : raster.dirty) {
+      update(rc.translated(layout_.board.topLeft()));
     }
   }
+  shown_motion_ = raster.motion;
+  syncAnimation();
+}
 
+
+void View::blitPatch(const BoardPatch& patch) {
+  const QRect rc = QRect(patch.at, patch.image.size()) & board_image_.rect();
+  if (rc.isEmpty() || patch.image.format() != board_image_.format()) return;
+  const size_t bytes = static_cast<size_t>(rc.width()) * sizeof(QRgb);
+  for (int y = rc.top(); y <= rc.bottom(); ++y) {
+    const uchar* src = patch.image.constScanLine(y - patch.at.y()) +
+                       (rc.left() - patch.at.x()) * sizeof(QRgb);
+    std::memcpy(board_image_.scanLine(y) + rc.left() * sizeof(QRgb), src,
+                bytes);
+  }
+}
+
+
+QRect View::cellRect(int r, int c) const {
+  const int cell = layout_.cell;
+  return QRect(layout_.grid.left() + c * cell, layout_.grid.top() + r * cell,
+               cell, cell);
+}
+
+
+bool View::syncHud(const SimFrame* frame, bool force) {
+  GameInfo_t g = sim_frame_info(frame);
+  const int values[6] = {g.score, g.high_score, g.level, g.speed, g.pause,
+                         frame ? frame->game_over : 0};
+  static const char* const kLabels[4] = {"SCORE", "HIGH", "LEVEL", "SPEED"};
+  bool changed = force;
+  for (int i = 0; i < 6; ++i) {
+    if (!force && hud_values_[i] == values[i]) continue;
+    hud_values_[i] = values[i];
+    if (i < 4) {
+      hud_text_[i].setText(
+          QStringLiteral("%1: %2")
+              .arg(QString::fromLatin1(kLabels[i]))
+              .arg(values[i]));
+    }
+    changed = true;
+  }
+  if (frame) {
+    for (int i = 0; i < 16; ++i) {
+      const int v = frame->next_cells[i];
+      if (shown_next_[i] == v) continue;
+      shown_next_[i] = v;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+
+void View::togglePerf() {
+  perf_visible_ = !perf_visible_;
+  if (perf_visible_) {
+    perf_meter_start(&perf_);
+    syncPerfText();
+  } else {
+    perf_meter_stop(&perf_);
+  }
+  update(layout_.hud);
+}
+
+
+void View::syncPerfText() {
+  const PerfSnapshot& s = perf_.shown;
+  perf_text_[0].setText(
+      QStringLiteral("paint %1 ms").arg(s.frame_ms, 0, 'f', 2));
+  perf_text_[1].setText(QStringLiteral("tick %1/%2 Hz")
+                            .arg(s.tick_hz, 0, 'f', 1)
+                            .arg(s.target_hz, 0, 'f', 1));
+  perf_text_[2].setText(
+      QStringLiteral("steps %1/s").arg(s.steps_per_s, 0, 'f', 0));
+  perf_text_[3].setText(
+      alloc_track_available()
+          ? QStringLiteral("alloc %1/frame").arg(s.allocs_per_frame, 0, 'f', 1)
+          : QStringLiteral("alloc n/a"));
+  perf_text_[4].setText(QStringLiteral("queue %1").arg(s.input_depth));
+}
+
+
+void View::drawBorder(QPainter& p, const QRect& r) {
+  p.save();
+  p.setPen(QPen(QColor(90, 90, 90), 2));
+  p.drawRect(r.adjusted(0, 0, -1, -1));
   p.restore();
 }
 
@@ -125,26 +330,44 @@ void View::drawHUD(QPainter& p, const QRect& bounds, const GameInfo_t& g,
   f.setBold(true);
   p.setFont(f);
 
+  const int ascent = p.fontMetrics().ascent();
   int y = bounds.top() + 8;
   const int dy = 22;
-
-  auto line = [&](const QString& k, long long v) {
-    p.drawText(bounds.left() + 8, y, QString("%1: %2").arg(k).arg(v));
+  for (const QStaticText& text : hud_text_) {
+    p.drawStaticText(bounds.left() + 8, y - ascent, text);
     y += dy;
-  };
+  }
 
-  line("SCORE", g.score);
-  line("HIGH", g.high_score);
-  line("LEVEL", g.level);
-  line("SPEED", g.speed);
+  auto centered = [&](const QStaticText& text, int top) {
+    const int w = qRound(text.size().width());
+    p.drawStaticText(bounds.left() + (bounds.width() - w) / 2, top, text);
+  };
 
   if (g.pause) {
     p.setPen(QColor(255, 215, 0));
-    p.drawText(bounds.adjusted(0, 80, 0, 0), Qt::AlignHCenter, "PAUSED");
+    centered(paused_text_, bounds.top() + 80);
   }
   if (game_over) {
     p.setPen(QColor(255, 80, 80));
-    p.drawText(bounds.adjusted(0, 110, 0, 0), Qt::AlignHCenter, "GAME OVER");
+    centered(over_text_, bounds.top() + 110);
+  }
+
+  if (g.next && !next_image_.isNull()) {
+    p.setPen(QColor(200, 200, 200));
+    centered(next_text_, layout_.next.top() - 18);
+    p.drawImage(layout_.next, next_image_);
+  }
+
+  if (perf_visible_) {
+    f.setBold(false);
+    p.setFont(f);
+    p.setPen(QColor(120, 200, 255));
+    const int line = p.fontMetrics().height();
+    int py = bounds.bottom() - 8 - 5 * line;
+    for (const QStaticText& text : perf_text_) {
+      p.drawStaticText(bounds.left() + 8, py, text);
+      py += line;
+    }
   }
 
   p.restore();
@@ -155,22 +378,74 @@ View::View(QWidget* parent) : QWidget(parent) {
   setFocusPolicy(Qt::StrongFocus);
   setMinimumSize(480, 360);
 
-  timer_ = new QTimer(this);
-  connect(timer_, &QTimer::timeout, this, &View::onTick);
-  timer_->start(32);
+  next_text_.setText(QStringLiteral("NEXT"));
+  paused_text_.setText(QStringLiteral("PAUSED"));
+  over_text_.setText(QStringLiteral("GAME OVER"));
+  for (QStaticText* text : {&next_text_, &paused_text_, &over_text_}) {
+    text->setPerformanceHint(QStaticText::AggressiveCaching);
+  }
+  for (QStaticText& text : hud_text_) {
+    text.setPerformanceHint(QStaticText::AggressiveCaching);
+  }
+
+  anim_timer_ = new QTimer(this);
+  anim_timer_->setTimerType(Qt::PreciseTimer);
+  connect(anim_timer_, &QTimer::timeout, this, &View::onAnimate);
+
+  renderer_ = new BoardRenderer;
+  renderer_->moveToThread(&render_thread_);
+  connect(renderer_, &BoardRenderer::rendered, this, &View::onRendered,
+          Qt::QueuedConnection);
+  render_thread_.setObjectName(QStringLiteral("board-render"));
+  render_thread_.start();
+
+  if (sim_start() && sim_frame_fd() >= 0) {
+    frame_notifier_ =
+        new QSocketNotifier(sim_frame_fd(), QSocketNotifier::Read, this);
+    connect(frame_notifier_, &QSocketNotifier::activated, this,
+            &View::onFrameReady);
+  }
+  relayout();
+  onFrameReady();
 }
 
 
 View::~View() {
-  if (timer_) timer_->stop();
+  if (anim_timer_) anim_timer_->stop();
+  if (frame_notifier_) frame_notifier_->setEnabled(false);
+  render_thread_.quit();
+  render_thread_.wait();
+  delete renderer_;
+  renderer_ = nullptr;
+  frame_ = nullptr;
+  sim_stop();
 }
 
 
-void View::onTick() {
-  if (isGameOver()) {
+void View::onFrameReady() {
+  const SimFrame* frame = sim_latest();
+  if (!frame || frame->seq == drawn_seq_) return;
+  frame_ = frame;
+  drawn_seq_ = frame->seq;
+  if (frame->input_id != latency_seen_id_) {
+    latency_seen_id_ = frame->input_id;
+    latency_pending_ns_ = frame->input_ns;
+    latency_seq_ = frame->seq;
+  }
+  if (latency_take_request()) {
+    latency_print(&input_latency_, "input-latency", stderr);
+  }
+  if (frame->game_over) {
     quit_pending_ = true;
   }
-  update();
+  if (frame->rows != rows_ || frame->cols != cols_) {
+    rows_ = frame->rows;
+    cols_ = frame->cols;
+    relayout();
+    return;
+  }
+  submitFrame(frame);
+  if (syncHud(frame, false)) update(layout_.hud);
 }
 
 
@@ -210,9 +485,14 @@ void View::keyPressEvent(QKeyEvent* ev) {
     ev->accept();
     return;
   }
+  if (ev->key() == Qt::Key_O) {
+    togglePerf();
+    ev->accept();
+    return;
+  }
   UserAction_t a;
   if (mapKeyToAction(ev->key(), a)) {
-    userInput(a, true);
+    sim_post_input(a, true);
     if (a == Terminate) {
       qApp->quit();
       return;
@@ -229,7 +509,7 @@ void View::keyReleaseEvent(QKeyEvent* ev) {
     return;
   }
   if (ev->key() == Qt::Key_Down) {
-    userInput(Down, false);
+    sim_post_input(Down, false);
     ev->accept();
     return;
   }
@@ -1,11 +1,19 @@
 #ifndef VIEW_H
 #define VIEW_H
 
+#include <QImage>
 #include <QPointer>
+#include <QSocketNotifier>
+#include <QStaticText>
+#include <QThread>
 #include <QTimer>
 #include <QWidget>
 
+#include "board_renderer.h"
 #include "brick_game_api.h"
+#include "latency.h"
+#include "perf_meter.h"
+#include "sim.h"
 
 
 class View : public QWidget {
@@ -16,24 +24,78 @@ class View : public QWidget {
   
   ~View() override;
 
+  
+  double lastPaintMs() const { return paint_ns_last_ / 1e6; }
+  double averagePaintMs() const {
+    return paint_count_ ? paint_ns_total_ / 1e6 / paint_count_ : 0.0;
+  }
+  double totalPaintMs() const { return paint_ns_total_ / 1e6; }
+  long long paintCount() const { return paint_count_; }
+  unsigned long long lastPaintAllocs() const { return paint_allocs_last_; }
+  unsigned long long lastPaintAllocBytes() const {
+    return paint_alloc_bytes_last_;
+  }
+  unsigned long long frameSeq() const { return drawn_seq_; }
+  unsigned long long renderedSeq() const { return rendered_seq_; }
+  const LatencyHist& inputLatency() const { return input_latency_; }
+
  protected:
   
   void paintEvent(QPaintEvent* event) override;
   
+  void resizeEvent(QResizeEvent* event) override;
+  
   void keyPressEvent(QKeyEvent* event) override;
   
   void keyReleaseEvent(QKeyEvent* event) override;
 
  private slots:
   
-  void onTick();
+  void onFrameReady();
+  
+  void onAnimate();
+  
+  void onRendered(const BoardRaster& raster);
 
  private:
   
-  void drawBorder(QPainter& p, const QRect& r);
+  struct Layout {
+    QRect bounds;
+    QRect board;
+    QRect grid;
+    QRect hud;
+    QRect next;
+    int cell = 1;
+    int next_cell = 1;
+  };
+
+  
+  void computeLayout();
+  
+  void relayout();
+  
+  void submitFrame(const SimFrame* frame);
+  
+  bool syncHud(const SimFrame* frame, bool force);
+  
+  void togglePerf();
+  
+  void syncPerfText();
+  
+  void blitPatch(const BoardPatch& patch);
+  
+  QRect cellRect(int r, int c) const;
+  
+  double motionProgress(const MotionHint_t& m) const;
   
-  void drawMatrix(QPainter& p, int** grid, int rows, int cols,
-                  const QRect& area);
+  QRect motionRect(const MotionHint_t& m) const;
+  
+  void drawMotion(QPainter& p, const MotionHint_t& m);
+  
+  void syncAnimation();
+
+  
+  void drawBorder(QPainter& p, const QRect& r);
   
   void drawHUD(QPainter& p, const QRect& bounds, const GameInfo_t& g,
                bool game_over);
@@ -50,7 +112,48 @@ class View : public QWidget {
   bool quit_pending_ = false;
 
   
-  QPointer<QTimer> timer_;
+  const SimFrame* frame_ = nullptr;
+  unsigned long long drawn_seq_ = 0;
+
+  
+  Layout layout_;
+  QImage board_image_;
+  QImage grid_image_;
+  QImage next_image_;
+  MotionHint_t shown_motion_ = {};
+  unsigned long long rendered_seq_ = 0;
+  BoardRenderer* renderer_ = nullptr;
+  QThread render_thread_;
+
+  
+  int hud_values_[6] = {-1, -1, -1, -1, -1, -1};
+  int shown_next_[16] = {};
+  QStaticText hud_text_[4];
+  QStaticText next_text_;
+  QStaticText paused_text_;
+  QStaticText over_text_;
+  QStaticText perf_text_[5];
+  bool perf_visible_ = false;
+  PerfMeter perf_ = {};
+
+  
+  qint64 paint_ns_last_ = 0;
+  qint64 paint_ns_total_ = 0;
+  long long paint_count_ = 0;
+  unsigned long long paint_allocs_last_ = 0;
+  unsigned long long paint_alloc_bytes_last_ = 0;
+
+  
+  LatencyHist input_latency_ = {};
+  unsigned latency_seen_id_ = 0;
+  long long latency_pending_ns_ = 0;
+  unsigned long long latency_seq_ = 0;
+
+  
+  QPointer<QSocketNotifier> frame_notifier_;
+  QPointer<QTimer> anim_timer_;
+  QRect motion_rect_;
+  int anim_interval_ms_ = 16;
 };
 
 #endif  